@@ -0,0 +1,81 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "io/run.hh"
+#include "posix/spawn.hh"
+
+using namespace std::literals;
+
+namespace {
+	using clock_type = std::chrono::steady_clock;
+
+	struct workload {
+		std::string_view name;
+		size_t count;
+		size_t threads;
+	};
+
+	clock_type::duration measure(io::posix::spawner which,
+	                             fs::path const& program,
+	                             workload const& load) {
+		io::posix::use_spawner(which);
+
+		auto const start = clock_type::now();
+		std::vector<std::jthread> threads{};
+		threads.reserve(load.threads);
+		for (size_t thread = 0; thread < load.threads; ++thread) {
+			auto const count = load.count / load.threads +
+			                   (thread < load.count % load.threads ? 1 : 0);
+			threads.emplace_back([&program, count] {
+				for (size_t index = 0; index < count; ++index) {
+					auto const result =
+					    io::run({.exec = program, .output = io::piped{}});
+					if (result.return_code) {
+						fmt::print(stderr, "{}: exit code {}\n",
+						           program.native(), result.return_code);
+						std::exit(1);
+					}
+				}
+			});
+		}
+		threads.clear();
+		return clock_type::now() - start;
+	}
+
+	void report(std::string_view spawner,
+	            workload const& load,
+	            clock_type::duration elapsed) {
+		using namespace std::chrono;
+		auto const us = duration_cast<duration<double, std::micro>>(elapsed);
+		fmt::print("{:<12} {:<9} {:>8} {:>12.1f} ms {:>10.3f} us/spawn\n",
+		           spawner, load.name, load.count, us.count() / 1000.0,
+		           us.count() / static_cast<double>(load.count));
+	}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	fs::path program = argc > 1 ? argv[1] : "/bin/true";
+	size_t threads = std::thread::hardware_concurrency();
+	if (argc > 2) threads = std::strtoull(argv[2], nullptr, 10);
+	if (!threads) threads = 1;
+
+	workload const loads[] = {
+	    {"serial"sv, 2'000, 1},
+	    {"parallel"sv, 2'000 * threads, threads},
+	};
+
+	fmt::print("program: {}\nthreads: {}\n", program.native(), threads);
+	for (auto const& load : loads) {
+		report("posix_spawn"sv, load,
+		       measure(io::posix::spawner::posix_spawn, program, load));
+		report("clone_vfork"sv, load,
+		       measure(io::posix::spawner::clone_vfork, program, load));
+	}
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <latch>
+#include <string_view>
+#include <thread>
+#include "mt/stealing_pool.hh"
+#include "mt/thread_pool.hh"
+
+using namespace std::literals;
+
+namespace {
+	using clock_type = std::chrono::steady_clock;
+
+	struct workload {
+		std::string_view name;
+		size_t count;
+		std::chrono::microseconds sleep;
+	};
+
+	std::packaged_task<test_results()> make_task(std::latch& done,
+	                                             std::chrono::microseconds sleep) {
+		return std::packaged_task<test_results()>{[&done, sleep] {
+			if (sleep.count()) std::this_thread::sleep_for(sleep);
+			done.count_down();
+			return test_results{outcome::OK, {}, {}, {}};
+		}};
+	}
+
+	template <typename Pool>
+	clock_type::duration measure(size_t threads, workload const& load) {
+		std::latch done{static_cast<std::ptrdiff_t>(load.count)};
+		Pool pool{threads};
+
+		auto const start = clock_type::now();
+		for (size_t index = 0; index < load.count; ++index)
+			pool.push(make_task(done, load.sleep));
+		done.wait();
+		return clock_type::now() - start;
+	}
+
+	void report(std::string_view pool,
+	            workload const& load,
+	            clock_type::duration elapsed) {
+		using namespace std::chrono;
+		auto const us = duration_cast<duration<double, std::micro>>(elapsed);
+		fmt::print("{:<14} {:<6} {:>8} {:>12.1f} ms {:>10.3f} us/task\n", pool,
+		           load.name, load.count, us.count() / 1000.0,
+		           us.count() / static_cast<double>(load.count));
+	}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	size_t threads = std::thread::hardware_concurrency();
+	if (argc > 1) threads = std::strtoull(argv[1], nullptr, 10);
+	if (!threads) threads = 1;
+
+	workload const loads[] = {
+	    {"empty"sv, 200'000, 0us},
+	    {"1ms"sv, 200 * threads, 1000us},
+	};
+
+	fmt::print("threads: {}\n", threads);
+	for (auto const& load : loads) {
+		report("mt_queue"sv, load, measure<mt::thread_pool>(threads, load));
+		report("work-stealing"sv, load,
+		       measure<mt::stealing_pool>(threads, load));
+	}
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a; unlike std::hash, it is the same on every machine and in
+// every run
+class fnv1a {
+public:
+	fnv1a& update(void const* data, size_t length) noexcept {
+		auto bytes = static_cast<unsigned char const*>(data);
+		for (size_t index = 0; index < length; ++index) {
+			value_ ^= bytes[index];
+			value_ *= 0x0000'0100'0000'01b3u;
+		}
+		return *this;
+	}
+	fnv1a& update(std::string_view bytes) noexcept {
+		return update(bytes.data(), bytes.size());
+	}
+	fnv1a& update(std::uint64_t number) noexcept {
+		return update(&number, sizeof(number));
+	}
+	// length-prefixed, so that ("ab", "c") and ("a", "bc") differ
+	fnv1a& field(std::string_view bytes) noexcept {
+		return update(std::uint64_t{bytes.size()}).update(bytes);
+	}
+
+	std::uint64_t value() const noexcept { return value_; }
+
+	static std::uint64_t of(std::string_view bytes) noexcept {
+		return fnv1a{}.update(bytes).value();
+	}
+
+private:
+	std::uint64_t value_{0xcbf2'9ce4'8422'2325u};
+};
@@ -80,6 +80,31 @@ namespace chaiscript::bootstrap::standard_library {
 	}
 }  // namespace chaiscript::bootstrap::standard_library
 
+namespace chaiscript::runner {
+	// The directory of the test, while one of its script handlers runs;
+	// the tests share the process cwd, so the relative paths given to the
+	// fs functions are resolved against it instead.
+	inline thread_local fs::path const* script_cwd = nullptr;
+
+	struct script_cwd_scope {
+		explicit script_cwd_scope(fs::path const& cwd) : prev_{script_cwd} {
+			script_cwd = &cwd;
+		}
+		~script_cwd_scope() { script_cwd = prev_; }
+		script_cwd_scope(script_cwd_scope const&) = delete;
+		script_cwd_scope& operator=(script_cwd_scope const&) = delete;
+
+	private:
+		fs::path const* prev_;
+	};
+
+	inline fs::path script_path(std::string const& path) {
+		auto result = shell::make_u8path(path);
+		if (script_cwd && result.is_relative()) return *script_cwd / result;
+		return result;
+	}
+}  // namespace chaiscript::runner
+
 void register_fs(chaiscript::ChaiScript& chai, chaiscript::Namespace& fs) {
 	using namespace chaiscript;
 
@@ -109,15 +134,15 @@ void register_fs(chaiscript::ChaiScript& chai, chaiscript::Namespace& fs) {
 		return shell::get_path(shell::make_u8path(p1) / shell::make_u8path(p2));
 	}));
 	fs["abspath"] = var(fun([](std::string const& path) {
-		return shell::get_u8path(fs::absolute(shell::make_u8path(path)));
+		return shell::get_u8path(fs::absolute(runner::script_path(path)));
 	}));
 	fs["create_directories"] = var(fun([](std::string const& path) {
-		fs::create_directories(shell::make_u8path(path));
+		fs::create_directories(runner::script_path(path));
 	}));
 	fs["copy"] = var(fun([](std::string const& src, std::string const& dst) {
-		fs::copy(shell::make_u8path(src), shell::make_u8path(dst));
+		fs::copy(runner::script_path(src), runner::script_path(dst));
 	}));
 	fs["directory_iterator"] = var(fun([](std::string const& path) {
-		return fs::directory_iterator{shell::make_u8path(path)};
+		return fs::directory_iterator{runner::script_path(path)};
 	}));
 }
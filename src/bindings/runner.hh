@@ -76,6 +76,10 @@ namespace chaiscript::runner {
 			      return shell::get_path(test.path(path));
 		      }),
 		      "path");
+		m.add(fun([](testbed::test const& test) {
+			      return shell::get_path(test.cwd());
+		      }),
+		      "cwd");
 	}
 
 	static bool is_regex_special(char c) {
@@ -7,6 +7,7 @@
 #include <fmt/format.h>
 #include <chaiscript/chaiscript.hpp>
 #include <chaiscript/dispatchkit/bootstrap_stl.hpp>
+#include <stdexcept>
 #include <string>
 #include "base/shell.hh"
 #include "base/str.hh"
@@ -46,23 +47,27 @@ namespace {
 		if (!ee.detail.empty()) fmt::print(stderr, "{}\n", ee.detail);
 	}
 
-	bool run_tool(fs::path const& name,
-	              std::span<std::string const> args,
-	              fs::path const& cwd,
-	              std::string& listing) {
+	// the name is taken by value, as the coroutine may outlive the
+	// handler's lambda
+	mt::co_task<bool> run_tool(fs::path name,
+	                           std::span<std::string const> args,
+	                           testbed::test& self,
+	                           std::string& listing) {
 		io::args_storage copy{.stg{args.begin(), args.end()}};
-		auto proc = io::run({.exec = name,
-		                     .args = copy.args(),
-		                     .cwd = &cwd,
-		                     .output = io::terminal{},
-		                     .error = io::redir_to_output{},
-		                     .debug = &listing});
+		auto proc = co_await mt::process{{.exec = name,
+		                                  .args = copy.args(),
+		                                  .cwd = &self.cwd(),
+		                                  .output = io::piped{},
+		                                  .error = io::redir_to_output{},
+		                                  .debug = &listing,
+		                                  .timeout = self.time_left()}};
+		self.timed_out(proc);
 
 		if (!proc.output.empty()) {
 			if (proc.output.back() != '\n') proc.output.push_back('\n');
 			listing.append(proc.output);
 		}
-		return proc.return_code == 0;
+		co_return proc.return_code == 0;
 	}
 
 	void git_config(std::string&& name, std::string&& value) {
@@ -135,6 +140,26 @@ struct Project {
 			      project.info.common_patches[regex] = value;
 		      }),
 		      "register_patch");
+		m.add(fun([](Project& project, std::string const& name,
+		             unsigned capacity) {
+			      project.info.resources[name] = capacity;
+		      }),
+		      "resource");
+		m.add(fun([](Project& project, unsigned seconds) {
+			      project.info.timeout =
+			          testbed::timeouts::all(std::chrono::seconds{seconds});
+		      }),
+		      "timeout");
+		m.add(fun([](Project& project, std::string const& phase,
+		             unsigned seconds) {
+			      auto budget = project.info.timeout.phase(phase);
+			      if (!budget) {
+				      throw std::runtime_error(
+				          fmt::format("unknown test phase `{}`", phase));
+			      }
+			      *budget = std::chrono::seconds{seconds};
+		      }),
+		      "timeout");
 
 		bootstrap::standard_library::span_type<std::span<std::string const>>(
 		    "StringSpan", m);
@@ -147,6 +172,8 @@ struct Project {
 			                               std::span<std::string const> args,
 			                               std::string&) {
 				    try {
+					    chaiscript::runner::script_cwd_scope in_test{
+					        handler.cwd()};
 					    return code(static_cast<testbed::test&>(handler), args);
 				    } catch (chaiscript::exception::eval_error const& ee) {
 					    print_exception(ee);
@@ -258,11 +285,11 @@ std::map<std::string, testbed::handler_info> Chai::ProjectInfo::handlers()
 	for (auto const& app : allowed) {
 		results[app] = {
 		    .min_args = 0,
-		    .handler =
+		    .async_handler =
 		        [app](testbed::commands& handler,
 		              std::span<std::string const> args, std::string& listing) {
 			        auto& self = static_cast<testbed::test&>(handler);
-			        return run_tool(app, args, self.cwd(), listing);
+			        return run_tool(app, args, self, listing);
 		        },
 		};
 
@@ -277,11 +304,11 @@ std::map<std::string, testbed::handler_info> Chai::ProjectInfo::handlers()
 
 	results[target] = {
 	    .min_args = 0,
-	    .handler =
+	    .async_handler =
 	        [](testbed::commands& handler, std::span<std::string const> args,
 	           std::string& listing) {
 		        auto& self = static_cast<testbed::test&>(handler);
-		        return run_tool(self.current_rt->rt_target, args, self.cwd(),
+		        return run_tool(self.current_rt->rt_target, args, self,
 		                        listing);
 	        },
 	};
@@ -9,6 +9,7 @@
 #include <optional>
 #include <string>
 #include <vector>
+#include "testbed/timeouts.hh"
 
 namespace testbed {
 	struct handler_info;
@@ -32,6 +33,8 @@ public:
 		std::optional<std::string> default_dataset;
 		std::map<std::string, std::string> environment;
 		std::map<std::string, std::string> common_patches;
+		std::map<std::string, unsigned> resources;
+		testbed::timeouts timeout;
 		std::map<std::string, testbed::handler_info> script_handlers;
 		std::function<void(std::string const&, testbed::runtime&)> installer;
 
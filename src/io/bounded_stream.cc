@@ -0,0 +1,95 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "io/bounded_stream.hh"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+
+namespace io {
+	fs::path spill_path(fs::path const& dir, std::string_view label) {
+		static std::atomic<unsigned> counter{};
+		return dir / fmt::format("{}-{}.spill", label, ++counter);
+	}
+
+	std::string read_spilled(spilled const& stream,
+	                         size_t offset,
+	                         size_t length) {
+		std::string result{};
+		if (offset >= stream.size) return result;
+		length = std::min(length, stream.size - offset);
+
+		auto file = fopen(stream.path, "rb");
+		if (!file || (offset && !file.skip(offset))) return result;
+		result.resize(length);
+		result.resize(file.load(result.data(), length));
+		return result;
+	}
+
+	void append_spilled(spilled& stream, std::string_view data) {
+		auto file = fopen(stream.path, "ab");
+		if (!file) return;
+		stream.size += file.store(data.data(), data.size());
+	}
+
+	bounded_stream::bounded_stream(spill_opts const& opts,
+	                               std::string_view label)
+	    : opts_{opts}, label_{label} {}
+
+	void bounded_stream::append(char const* data, size_t size) {
+		total_ += size;
+
+		if (opts_ && kept_ + size > opts_->limit) {
+			if (!spill_ && !failed_) start_spill();
+			if (spill_) spill_.store(data, size);
+			// the rest of the stream is not kept in memory
+			size = opts_->limit - kept_;
+		}
+		store(data, size);
+	}
+
+	std::string bounded_stream::take(std::optional<spilled>& spill) {
+		std::string result{};
+		result.reserve(kept_);
+		for (auto const& chunk : chunks_)
+			result.append(chunk);
+		chunks_.clear();
+		kept_ = 0;
+
+		if (spill_) {
+			spill_.close();
+			spill = spilled{.path = path_, .size = total_};
+		}
+		return result;
+	}
+
+	void bounded_stream::start_spill() {
+		std::error_code ec{};
+		fs::create_directories(opts_->dir, ec);
+		path_ = spill_path(opts_->dir, label_);
+		spill_.open(path_, "wb");
+		if (!spill_) {
+			// the capture is still cut at the limit; the report will not
+			// point to any file
+			failed_ = true;
+			return;
+		}
+		for (auto const& chunk : chunks_)
+			spill_.store(chunk.data(), chunk.size());
+	}
+
+	void bounded_stream::store(char const* data, size_t size) {
+		while (size) {
+			if (chunks_.empty() || chunks_.back().size() == CHUNK) {
+				chunks_.emplace_back();
+				chunks_.back().reserve(CHUNK);
+			}
+			auto& chunk = chunks_.back();
+			auto const piece = std::min(size, CHUNK - chunk.size());
+			chunk.append(data, piece);
+			data += piece;
+			size -= piece;
+			kept_ += piece;
+		}
+	}
+}  // namespace io
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "io/file.hh"
+
+namespace fs = std::filesystem;
+
+namespace io {
+	// Limit of a captured stream: the first `limit` bytes are kept in
+	// memory, the whole stream goes to a file in `dir` once it is longer.
+	struct spill_opts {
+		size_t limit{};
+		fs::path dir{};
+	};
+
+	// A stream, which outgrew spill_opts::limit; `path` holds all `size`
+	// bytes of it, while the capture keeps only the first ones.
+	struct spilled {
+		fs::path path{};
+		size_t size{};
+
+		bool operator==(spilled const&) const noexcept = default;
+	};
+
+	// a new name in the `dir`, e.g. "stdout-3.spill"
+	fs::path spill_path(fs::path const& dir, std::string_view label);
+
+	// `length` bytes from `offset` (or less, at the end of the file)
+	std::string read_spilled(spilled const& stream,
+	                         size_t offset,
+	                         size_t length);
+
+	// adds `data` at the end of the spilled stream, e.g. the output of
+	// the next command of a test
+	void append_spilled(spilled& stream, std::string_view data);
+
+	// Collects a stream read in pieces. The pieces are kept in chunks of
+	// fixed size, so a long stream is not copied over and over, while
+	// the string grows; once past the limit, every byte read so far,
+	// and each one after, goes to the spill file.
+	class bounded_stream {
+	public:
+		bounded_stream() = default;
+		bounded_stream(spill_opts const& opts, std::string_view label);
+
+		void append(char const* data, size_t size);
+		// joins the chunks kept in memory and closes the spill file
+		std::string take(std::optional<spilled>& spill);
+
+	private:
+		static constexpr size_t CHUNK = 64 * 1024;
+
+		void start_spill();
+		void store(char const* data, size_t size);
+
+		std::vector<std::string> chunks_{};
+		size_t kept_{};
+		size_t total_{};
+		std::optional<spill_opts> opts_{};
+		std::string_view label_{};
+		fs::path path_{};
+		file spill_{};
+		bool failed_{false};
+	};
+}  // namespace io
@@ -0,0 +1,121 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "io/env_block.hh"
+
+namespace io {
+	namespace {
+		std::string entry_of(std::string_view name, std::string_view value) {
+			std::string result{};
+			result.reserve(name.size() + value.size() + 1);
+			result.append(name);
+			result.push_back('=');
+			result.append(value);
+			return result;
+		}
+
+		char* pointer_to(std::string const& entry) {
+			return const_cast<char*>(entry.c_str());
+		}
+	}  // namespace
+
+	env_block::env_block() : base_{std::make_shared<entries const>()} {
+		rebuild();
+	}
+
+	env_block::env_block(std::map<std::string, std::string> const& base) {
+		entries serialized{};
+		for (auto const& [name, value] : base)
+			serialized.emplace_hint(serialized.end(), name,
+			                        entry_of(name, value));
+		base_ = std::make_shared<entries const>(std::move(serialized));
+		rebuild();
+	}
+
+	env_block::env_block(env_block const& other)
+	    : base_{other.base_}, changes_{other.changes_} {
+		rebuild();
+	}
+
+	env_block& env_block::operator=(env_block const& other) {
+		if (this != &other) {
+			base_ = other.base_;
+			changes_ = other.changes_;
+			rebuild();
+		}
+		return *this;
+	}
+
+	std::optional<std::string_view> env_block::get(
+	    std::string_view name) const {
+		std::string_view entry{};
+		if (auto it = changes_.find(name); it != changes_.end()) {
+			if (!it->second) return std::nullopt;
+			entry = *it->second;
+		} else if (auto base = base_->find(name); base != base_->end()) {
+			entry = base->second;
+		} else {
+			return std::nullopt;
+		}
+		return entry.substr(name.size() + 1);
+	}
+
+	void env_block::set(std::string const& name, std::string_view value) {
+		changes_[name] = entry_of(name, value);
+		rebuild();
+	}
+
+	void env_block::erase(std::string const& name) {
+		changes_[name] = std::nullopt;
+		rebuild();
+	}
+
+	void env_block::append(std::string const& name,
+	                       std::string_view item,
+	                       char separator) {
+		auto const current = get(name);
+		if (!current) return set(name, item);
+
+		std::string value{};
+		value.reserve(current->size() + item.size() + 1);
+		value.append(*current);
+		value.push_back(separator);
+		value.append(item);
+		set(name, value);
+	}
+
+	void env_block::prepend(std::string const& name,
+	                        std::string_view item,
+	                        char separator) {
+		auto const current = get(name);
+		if (!current) return set(name, item);
+
+		std::string value{};
+		value.reserve(current->size() + item.size() + 1);
+		value.append(item);
+		value.push_back(separator);
+		value.append(*current);
+		set(name, value);
+	}
+
+	// merges the base with the changes; both are ordered by names
+	void env_block::rebuild() {
+		envp_.clear();
+		envp_.reserve(base_->size() + changes_.size() + 1);
+
+		auto base = base_->begin();
+		auto change = changes_.begin();
+		while (base != base_->end() || change != changes_.end()) {
+			if (change == changes_.end() ||
+			    (base != base_->end() && base->first < change->first)) {
+				envp_.push_back(pointer_to(base->second));
+				++base;
+				continue;
+			}
+			if (base != base_->end() && base->first == change->first) ++base;
+			if (change->second) envp_.push_back(pointer_to(*change->second));
+			++change;
+		}
+		envp_.push_back(nullptr);
+	}
+}  // namespace io
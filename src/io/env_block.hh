@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace io {
+	// Environment of a child process. The base is serialized into
+	// "NAME=value" strings once and shared by every copy of the block;
+	// a copy only records its own changes on top of it, and keeps the
+	// `envp` array, ready for the spawn, up to date.
+	class env_block {
+	public:
+		env_block();
+		explicit env_block(std::map<std::string, std::string> const& base);
+		env_block(env_block const& other);
+		env_block& operator=(env_block const& other);
+		env_block(env_block&&) = default;
+		env_block& operator=(env_block&&) = default;
+
+		std::optional<std::string_view> get(std::string_view name) const;
+		void set(std::string const& name, std::string_view value);
+		void erase(std::string const& name);
+		// adds the item to a list variable, like PATH
+		void append(std::string const& name,
+		            std::string_view item,
+		            char separator);
+		void prepend(std::string const& name,
+		             std::string_view item,
+		             char separator);
+
+		// "NAME=value" strings, ordered by names, terminated by nullptr
+		char* const* envp() const noexcept { return envp_.data(); }
+
+		template <typename Callback>
+		void visit(Callback&& cb) const {
+			for (auto it = envp(); *it; ++it) {
+				std::string_view entry{*it};
+				auto const enter = entry.find('=');
+				cb(entry.substr(0, enter), entry.substr(enter + 1));
+			}
+		}
+
+	private:
+		using entries = std::map<std::string, std::string, std::less<>>;
+		// nullopt marks a variable erased from the base
+		using changes =
+		    std::map<std::string, std::optional<std::string>, std::less<>>;
+
+		void rebuild();
+
+		std::shared_ptr<entries const> base_{};
+		changes changes_{};
+		std::vector<char*> envp_{};
+	};
+}  // namespace io
@@ -0,0 +1,25 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace io {
+	struct load_sample {
+		std::chrono::steady_clock::time_point taken{};
+		// system-wide CPU time, in whatever units the system reports it
+		std::uint64_t busy{};
+		std::uint64_t idle{};
+		std::uint64_t iowait{};
+		// CPU time used by all the children reaped so far
+		std::chrono::microseconds children{};
+		// threads ready to run right now, if the system tells
+		std::optional<unsigned> runnable{};
+	};
+
+	// nullopt, if the system does not report its CPU times
+	std::optional<load_sample> sample_load();
+}  // namespace io
@@ -0,0 +1,36 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "io/program_cache.hh"
+
+namespace io {
+	program_cache& program_cache::instance() {
+		static program_cache cache{};
+		return cache;
+	}
+
+	program_cache::stats program_cache::counters() const {
+		std::lock_guard lock{m_};
+		return stats_;
+	}
+
+	std::optional<fs::path> program_cache::lookup(
+	    string_type const& search_path,
+	    string_type const& program) {
+		std::lock_guard lock{m_};
+		auto it = programs_.find({search_path, program});
+		if (it == programs_.end()) {
+			++stats_.misses;
+			return std::nullopt;
+		}
+		++stats_.hits;
+		return it->second;
+	}
+
+	void program_cache::store(string_type const& search_path,
+	                          string_type const& program,
+	                          fs::path const& executable) {
+		std::lock_guard lock{m_};
+		programs_[{search_path, program}] = executable;
+	}
+}  // namespace io
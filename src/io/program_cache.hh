@@ -0,0 +1,60 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace io {
+	// Executables found on PATH by io::run, so that a program started over
+	// and over (the target, git, cmake, the tools of the prepare steps)
+	// is looked up once. The search path itself is part of the key, so
+	// any change to PATH is a miss. It is the runner's own PATH, the mocks
+	// of a test only reach the environment of the child, so they never
+	// change what is found here. Programs, which were not found, are not
+	// remembered; they might get installed later.
+	class program_cache {
+	public:
+		using string_type = fs::path::string_type;
+
+		struct stats {
+			size_t hits{};
+			size_t misses{};
+		};
+
+		static program_cache& instance();
+
+		template <typename Resolve>
+		fs::path find(string_type const& search_path,
+		              string_type const& program,
+		              Resolve&& resolve) {
+			if (auto cached = lookup(search_path, program))
+				return std::move(*cached);
+			auto result = resolve();
+			if (!result.empty()) store(search_path, program, result);
+			return result;
+		}
+
+		stats counters() const;
+
+	private:
+		using key_type = std::pair<string_type, string_type>;
+
+		std::optional<fs::path> lookup(string_type const& search_path,
+		                               string_type const& program);
+		void store(string_type const& search_path,
+		           string_type const& program,
+		           fs::path const& executable);
+
+		mutable std::mutex m_{};
+		std::map<key_type, fs::path> programs_{};
+		stats stats_{};
+	};
+}  // namespace io
@@ -0,0 +1,43 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace io {
+	using std::chrono::microseconds;
+
+	// What a child took from the system, until it was reaped. The CPU
+	// times, faults and switches include the descendants it waited for;
+	// a counter, which the system does not report, stays at zero.
+	struct resource_usage {
+		// from the start to the exit, as seen by the runner
+		microseconds wall{};
+		microseconds user{};
+		microseconds system{};
+		size_t max_rss_kb{};
+		size_t minor_faults{};
+		size_t major_faults{};
+		size_t voluntary_switches{};
+		size_t involuntary_switches{};
+
+		// for processes run one after another: the times and counters add
+		// up, the peak memory is the higher one
+		resource_usage& operator+=(resource_usage const& rhs) noexcept {
+			wall += rhs.wall;
+			user += rhs.user;
+			system += rhs.system;
+			max_rss_kb = std::max(max_rss_kb, rhs.max_rss_kb);
+			minor_faults += rhs.minor_faults;
+			major_faults += rhs.major_faults;
+			voluntary_switches += rhs.voluntary_switches;
+			involuntary_switches += rhs.involuntary_switches;
+			return *this;
+		}
+
+		bool operator==(resource_usage const&) const noexcept = default;
+	};
+}  // namespace io
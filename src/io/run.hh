@@ -4,13 +4,18 @@
 #pragma once
 
 #include <args/parser.hpp>
+#include <chrono>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <span>
 #include <string>
 #include <utility>
 #include <variant>
 #include <vector>
+#include "io/bounded_stream.hh"
+#include "io/env_block.hh"
+#include "io/resource_usage.hh"
 
 namespace fs = std::filesystem;
 
@@ -19,8 +24,21 @@ namespace io {
 		int return_code{};
 		std::string output{};
 		std::string error{};
+		bool cancelled{false};
+		bool timed_out{false};
+		// set, when the stream outgrew run_opts::spill; the string above
+		// keeps only the first bytes of it
+		std::optional<spilled> output_spill{};
+		std::optional<spilled> error_spill{};
+		// not compared; the same program never takes the same time twice
+		resource_usage rusage{};
 
-		bool operator==(capture const&) const noexcept = default;
+		// a spilled stream is never equal, only its first bytes are known
+		bool operator==(capture const& rhs) const noexcept {
+			return return_code == rhs.return_code && output == rhs.output &&
+			       error == rhs.error && !output_spill && !error_spill &&
+			       !rhs.output_spill && !rhs.error_spill;
+		}
 	};
 
 	struct args_storage {
@@ -45,7 +63,16 @@ namespace io {
 	TAG_STRUCT(devnull);
 	TAG_STRUCT(redir_to_output);
 	TAG_STRUCT(redir_to_error);
-	TAG_STRUCT(terminal);
+
+	// A pseudo-terminal, where the system has one, so the child takes its
+	// tty code paths; `columns` and `rows` are the window size reported
+	// to it.
+	struct terminal {
+		unsigned short columns{80};
+		unsigned short rows{24};
+
+		bool operator==(terminal const&) const noexcept = default;
+	};
 
 	struct stream_decl : std::variant<std::nullptr_t,
 	                                  piped,
@@ -81,19 +108,42 @@ namespace io {
 		fs::path const& exec;
 		args::arglist args{};
 		fs::path const* cwd{nullptr};
-		std::map<std::string, std::string> const* env{nullptr};
+		env_block const* env{nullptr};
 		std::optional<std::string_view> input{};
+		// connected to the standard input as is, instead of the `input`
+		fs::path const* input_file{nullptr};
 		stream_decl output{};
 		stream_decl error{};
+		// when set, the captured streams are cut at the limit, see
+		// capture::output_spill; not supported on Windows
+		std::optional<spill_opts> spill{};
 		std::string* debug{nullptr};
+		// when set and the process is still running after that long, its
+		// process group is killed and capture::timed_out is raised; the
+		// output gathered up to that point is kept
+		std::optional<std::chrono::milliseconds> timeout{};
+		// keeps the child in the runner's process group, so it may read
+		// from the terminal, e.g. an interactive shell; such a child is
+		// left alone by cancel_all() and by the `timeout`
+		bool foreground{false};
 	};
 	capture run(run_opts const& options);
 
+	// Starts the process and returns; `on_done` gets the result, possibly
+	// on another thread, once the process is gone. Only the `input` needs
+	// to outlive the call. Where the process cannot be handed over to an
+	// event loop, it is waited for before returning.
+	void run_async(run_opts const& options,
+	               std::move_only_function<void(capture&&)> on_done);
+	// true, if run_async() returns before the process is gone, so the
+	// calling thread is free while it runs
+	bool runs_async() noexcept;
+
 	struct call_opts {
 		fs::path const& exec;
 		args::arglist args{};
 		fs::path const* cwd{nullptr};
-		std::map<std::string, std::string> const* env{nullptr};
+		env_block const* env{nullptr};
 		std::string* debug{nullptr};
 	};
 	inline int call(call_opts const& options) {
@@ -106,6 +156,20 @@ namespace io {
 		    .return_code;
 	}  // namespace io
 
+	// Stops every process still running inside run(): first with SIGTERM
+	// sent to its process group, then, once the grace period is over, with
+	// SIGKILL. Any run() called afterwards returns -ECANCELED without
+	// starting anything.
+	void cancel_all(std::chrono::milliseconds grace);
+	bool cancelled() noexcept;
+	// lets run() start processes again after cancel_all(), e.g. for the
+	// next pass of --watch
+	void resume() noexcept;
+	// On SIGINT or SIGTERM (Ctrl+C or Ctrl+Break on Windows), calls
+	// cancel_all() and only then lets the runner go down, so no child is
+	// left running on its own. Meant to be called once, by main.
+	void cancel_on_signals(std::chrono::milliseconds grace);
+
 	std::optional<fs::path> find_program(std::span<std::string const> names,
 	                                     fs::path const& hint);
 }  // namespace io
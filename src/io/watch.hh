@@ -0,0 +1,58 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace io {
+	// Collects the names of files written, moved or removed in the
+	// watched directories.
+	class watcher {
+	public:
+		// nullptr, if the system cannot watch files
+		static std::unique_ptr<watcher> create();
+
+		~watcher();
+		watcher(watcher const&) = delete;
+		watcher& operator=(watcher const&) = delete;
+
+		// the directory and all its subdirectories, including the ones
+		// created later
+		bool add_tree(fs::path const& dir);
+		// a single file; it does not have to exist yet
+		bool add_file(fs::path const& filename);
+
+		// Blocks until something changes, then gathers changes until
+		// none come for the `settle` time, e.g. while a linker writes the
+		// target in many steps. A removed directory, or all of them, if
+		// the system lost track of the changes, is reported as a whole:
+		// its path, or, if narrowed down, its watched files.
+		std::vector<fs::path> wait(std::chrono::milliseconds settle);
+
+	private:
+		struct watched_dir {
+			fs::path path{};
+			bool recursive{false};
+			// if not empty, changes to other files are ignored
+			std::set<fs::path> names{};
+		};
+
+		explicit watcher(int fd) : fd_{fd} {}
+		bool add_dir(fs::path const& dir, bool recursive);
+		void read_events(std::set<fs::path>& changes);
+		static void report_all(watched_dir const& watched,
+		                       std::set<fs::path>& changes);
+
+		int fd_{-1};
+		std::map<int, watched_dir> dirs_{};
+	};
+}  // namespace io
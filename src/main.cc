@@ -4,17 +4,26 @@
 #define NOMINMAX
 
 #include <fmt/format.h>
+#include <algorithm>
 #include <args/parser.hpp>
+#include <charconv>
 #include <filesystem>
 #include <future>
 #include <io/file.hh>
+#include <io/load.hh>
 #include <io/run.hh>
+#include <io/watch.hh>
 #include <iostream>
 #include <json/json.hpp>
 #include <map>
+#include <memory>
+#include <mt/coro.hh>
+#include <mt/stealing_pool.hh>
 #include <mt/thread_pool.hh>
 #include <optional>
+#include <set>
 #include <span>
+#include <tuple>
 #include <unordered_set>
 #include <vector>
 #include "base/cmake.hh"
@@ -22,6 +31,15 @@
 #include "base/str.hh"
 #include "chai.hh"
 #include "io/presets.hh"
+#include "io/program_cache.hh"
+#include "testbed/bench.hh"
+#include "testbed/discovery.hh"
+#include "testbed/dispatcher.hh"
+#include "testbed/history.hh"
+#include "testbed/load_control.hh"
+#include "testbed/result_cache.hh"
+#include "testbed/schedule.hh"
+#include "testbed/shard.hh"
 #include "testbed/test.hh"
 #include "version.hh"
 
@@ -63,10 +81,26 @@ std::error_code install(
 		fmt::print("{}: error: {}, {}\n", #NAME, ec.value(), ec.message()); \
 		return ec;                                                          \
 	}
-	FS(remove_all, (copy_dir, ec));
-
 	FS(create_directories, (copy_dir, ec));
 
+	{
+		std::vector<fs::path> previous{};
+		for (auto const& entry : fs::directory_iterator{copy_dir, ec}) {
+			// keep the timing database between the runs
+			if (entry.path().filename() == testbed::history::dirname)
+				continue;
+			previous.push_back(entry.path());
+		}
+		if (ec) {
+			fmt::print("directory_iterator: error: {}, {}\n", ec.value(),
+			           ec.message());
+			return ec;
+		}
+		for (auto const& path : previous) {
+			FS(remove_all, (path, ec));
+		}
+	}
+
 	{
 		io::args_storage cmake{.stg{"--install", shell::get_path(binary_dir),
 		                            "--config", CMAKE_BUILD_TYPE, "--prefix",
@@ -142,22 +176,39 @@ struct fmt::formatter<color> : fmt::formatter<fmt::string_view> {
 
 class counters {
 public:
-	void report(outcome outcome,
+	explicit counters(bool sorted_summary) : sorted_{sorted_summary} {}
+
+	void report(size_t index,
+	            outcome outcome,
 	            std::string_view test_ident,
 	            std::string_view message,
 	            std::string_view prepare,
 	            bool debug);
 
-	bool summary(size_t counter) const;
+	bool summary(size_t counter);
+	unsigned failed() const noexcept { return error_; }
 
 private:
+	using line = std::pair<size_t, std::string>;
+	void print(size_t index, std::string msg);
+
+	bool sorted_{false};
 	unsigned error_{0};
 	unsigned skip_{0};
 	unsigned save_{0};
-	std::vector<std::string> echo_{};
+	unsigned cancel_{0};
+	unsigned cache_{0};
+	std::vector<line> echo_{};
+	std::vector<line> all_{};
 };
 
-void counters::report(outcome result,
+void counters::print(size_t index, std::string msg) {
+	fmt::print("{}\n", msg);
+	if (sorted_) all_.push_back({index, std::move(msg)});
+}
+
+void counters::report(size_t index,
+                      outcome result,
                       std::string_view test_ident,
                       std::string_view message,
                       std::string_view prepare,
@@ -165,21 +216,29 @@ void counters::report(outcome result,
 	switch (result) {
 		case outcome::SKIPPED:
 			if (debug) fmt::print("{}", prepare);
-			fmt::print("{test_id} {color}SKIPPED{reset}\n",
-			           fmt::arg("test_id", test_ident),
-			           fmt::arg("color", color::skipped),
-			           fmt::arg("reset", color::reset));
+			print(index, fmt::format("{test_id} {color}SKIPPED{reset}",
+			                         fmt::arg("test_id", test_ident),
+			                         fmt::arg("color", color::skipped),
+			                         fmt::arg("reset", color::reset)));
 			++skip_;
 			return;
 		case outcome::SAVED:
 			if (debug) fmt::print("{}", prepare);
-			fmt::print("{test_id} {color}saved{reset}\n",
-			           fmt::arg("test_id", test_ident),
-			           fmt::arg("color", color::skipped),
-			           fmt::arg("reset", color::reset));
+			print(index, fmt::format("{test_id} {color}saved{reset}",
+			                         fmt::arg("test_id", test_ident),
+			                         fmt::arg("color", color::skipped),
+			                         fmt::arg("reset", color::reset)));
 			++skip_;
 			++save_;
 			return;
+		case outcome::CANCELLED:
+			if (debug) fmt::print("{}", prepare);
+			print(index, fmt::format("{test_id} {color}cancelled{reset}",
+			                         fmt::arg("test_id", test_ident),
+			                         fmt::arg("color", color::skipped),
+			                         fmt::arg("reset", color::reset)));
+			++cancel_;
+			return;
 		case outcome::CLIP_FAILED: {
 			fmt::print("{}", prepare);
 			auto msg = fmt::format(
@@ -187,8 +246,32 @@ void counters::report(outcome result,
 			    fmt::arg("test_id", test_ident), fmt::arg("message", message),
 			    fmt::arg("color", color::failed),
 			    fmt::arg("reset", color::reset));
-			fmt::print("{}\n", msg);
-			echo_.push_back(msg);
+			echo_.push_back({index, msg});
+			print(index, std::move(msg));
+			++error_;
+			return;
+		}
+		case outcome::PERF_FAILED: {
+			fmt::print("{}", prepare);
+			if (!message.empty()) fmt::print("{}\n", message);
+			auto msg = fmt::format("{test_id} {color}PERF_FAILED{reset}",
+			                       fmt::arg("test_id", test_ident),
+			                       fmt::arg("color", color::failed),
+			                       fmt::arg("reset", color::reset));
+			echo_.push_back({index, msg});
+			print(index, std::move(msg));
+			++error_;
+			return;
+		}
+		case outcome::TIMEOUT: {
+			fmt::print("{}", prepare);
+			auto msg = fmt::format("{test_id} {color}TIMEOUT ({phase}){reset}",
+			                       fmt::arg("test_id", test_ident),
+			                       fmt::arg("phase", message),
+			                       fmt::arg("color", color::failed),
+			                       fmt::arg("reset", color::reset));
+			echo_.push_back({index, msg});
+			print(index, std::move(msg));
 			++error_;
 			return;
 		}
@@ -200,22 +283,42 @@ void counters::report(outcome result,
 			                       fmt::arg("message", message),
 			                       fmt::arg("color", color::failed),
 			                       fmt::arg("reset", color::reset));
-			fmt::print("{}\n", msg);
-			echo_.push_back(msg);
+			echo_.push_back({index, msg});
+			print(index, std::move(msg));
 			++error_;
 			return;
 		}
 		case outcome::OK:
 			if (debug) fmt::print("{}", prepare);
-			fmt::print("{test_id} {color}PASSED{reset}\n",
-			           fmt::arg("test_id", test_ident),
-			           fmt::arg("color", color::passed),
-			           fmt::arg("reset", color::reset));
+			print(index, fmt::format("{test_id} {color}PASSED{reset}",
+			                         fmt::arg("test_id", test_ident),
+			                         fmt::arg("color", color::passed),
+			                         fmt::arg("reset", color::reset)));
+			return;
+		case outcome::CACHED:
+			print(index, fmt::format("{test_id} {color}CACHED{reset}",
+			                         fmt::arg("test_id", test_ident),
+			                         fmt::arg("color", color::passed),
+			                         fmt::arg("reset", color::reset)));
+			++cache_;
 			return;
 	}
 }
 
-bool counters::summary(size_t counter) const {
+bool counters::summary(size_t counter) {
+	if (sorted_) {
+		auto const by_index = [](line const& lhs, line const& rhs) {
+			return lhs.first < rhs.first;
+		};
+		std::stable_sort(all_.begin(), all_.end(), by_index);
+		std::stable_sort(echo_.begin(), echo_.end(), by_index);
+
+		fmt::print("\n");
+		for (auto const& [_, msg] : all_)
+			fmt::print("{}\n", msg);
+		fmt::print("\n");
+	}
+
 	fmt::print("Failed {}/{}\n", error_, counter);
 	if (skip_ != 0) {
 		auto const test_s = skip_ == 1 ? "test"sv : "tests"sv;
@@ -226,10 +329,18 @@ bool counters::summary(size_t counter) const {
 			fmt::print("Skipped {} {}\n", skip_, test_s);
 		}
 	}
+	if (cancel_ != 0) {
+		fmt::print("Cancelled {} {}\n", cancel_,
+		           cancel_ == 1 ? "test"sv : "tests"sv);
+	}
+	if (cache_ != 0) {
+		fmt::print("Reused {} cached {}\n", cache_,
+		           cache_ == 1 ? "pass"sv : "passes"sv);
+	}
 
 	if (!echo_.empty()) fmt::print("\n");
-	for (auto const& line : echo_)
-		fmt::print("{}\n", line);
+	for (auto const& [_, msg] : echo_)
+		fmt::print("{}\n", msg);
 
 	return error_ == 0;
 }
@@ -253,25 +364,47 @@ static inline std::string painted(color clr, std::string_view label) {
 	return fmt::format("{}{}{}", clr, label, color::reset);
 };
 
-test_results run_test2(testbed::test& tested,
-                       std::map<std::string, std::string> const& variables,
-                       testbed::runtime const& rt) {
-	auto copy = rt;
-	copy.temp_dir = rt.temp_dir / random_letters(16);
-
-	auto test_ident = fmt::format(
+std::string ident_of(testbed::test const& tested,
+                     testbed::runtime const& rt) {
+	return fmt::format(
 	    "{} {}",
 	    painted(color::counter,
-	            fmt::format("[{:>{}}/{}]", tested.index, copy.counter_digits,
-	                        copy.counter_total)),
+	            fmt::format("[{:>{}}/{}]", tested.index, rt.counter_digits,
+	                        rt.counter_total)),
 	    painted(color::name, tested.name));
+}
 
+mt::co_task<test_results> run_test2(
+    testbed::test& tested,
+    io::env_block const& variables,
+    testbed::runtime const& copy,
+    std::string const& test_ident) {
 	fmt::print("{}\n", test_ident);
-	auto actual = tested.run(variables, copy);
+	auto actual = co_await tested.run(variables, copy);
+
+	if (actual.capture ? actual.capture->cancelled : io::cancelled()) {
+		co_return {outcome::CANCELLED, test_ident, copy.temp_dir,
+		           std::move(actual.prepare)};
+	}
+
+	if (!actual.timed_out.empty()) {
+		// show what the test managed to print before it was killed
+		if (actual.capture && tested.expected) {
+			if (!actual.prepare.empty() && actual.prepare.back() != '\n')
+				actual.prepare.push_back('\n');
+			actual.prepare.append(
+			    tested.report(tested.clip(*actual.capture), copy));
+			actual.prepare.push_back('\n');
+		}
+		co_return {outcome::TIMEOUT, test_ident, copy.temp_dir,
+		           std::move(actual.prepare),
+		           std::string{actual.timed_out.data(),
+		                       actual.timed_out.size()}};
+	}
 
 	if (!actual.capture) {
-		return {outcome::SKIPPED, std::move(test_ident), copy.temp_dir,
-		        std::move(actual.prepare)};
+		co_return {outcome::SKIPPED, test_ident, copy.temp_dir,
+		           std::move(actual.prepare)};
 	}
 
 	if (!tested.expected) {
@@ -281,44 +414,289 @@ test_results run_test2(testbed::test& tested,
 		                            to_lines(actual.capture->output),
 		                            to_lines(actual.capture->error)});
 		tested.store();
-		return {outcome::SAVED, std::move(test_ident), copy.temp_dir,
-		        std::move(actual.prepare)};
+		co_return {outcome::SAVED, test_ident, copy.temp_dir,
+		           std::move(actual.prepare)};
 	}
 
 	auto clipped = tested.clip(*actual.capture);
 
 	if ((*actual.capture == *tested.expected) ||
 	    (clipped == *tested.expected)) {
-		return {outcome::OK, std::move(test_ident), copy.temp_dir,
-		        std::move(actual.prepare)};
+		if (!tested.limits.check(actual.capture->rusage).empty()) {
+			co_return {.result = outcome::PERF_FAILED,
+			           .task_ident = test_ident,
+			           .temp_dir = copy.temp_dir,
+			           .prepare = std::move(actual.prepare),
+			           .report = tested.report(clipped, copy),
+			           .rusage = actual.capture->rusage};
+		}
+		co_return {.result = outcome::OK,
+		           .task_ident = test_ident,
+		           .temp_dir = copy.temp_dir,
+		           .prepare = std::move(actual.prepare),
+		           .rusage = actual.capture->rusage};
 	}
 
-	return {outcome::FAILED, std::move(test_ident), copy.temp_dir,
-	        std::move(actual.prepare), tested.report(clipped, copy)};
+	co_return {.result = outcome::FAILED,
+	           .task_ident = test_ident,
+	           .temp_dir = copy.temp_dir,
+	           .prepare = std::move(actual.prepare),
+	           .report = tested.report(clipped, copy),
+	           .rusage = actual.capture->rusage};
 }
 
-test_results run_test(testbed::test& tested,
-                      std::map<std::string, std::string> const& variables,
-                      testbed::runtime const& rt) {
+mt::co_task<test_results> run_test(
+    testbed::test& tested,
+    io::env_block const& variables,
+    testbed::runtime const& rt,
+    testbed::result_cache& cache,
+    bool use_cache) {
+	// outside of the try, so a test stopped by an exception still has its
+	// name and its directory gets removed
+	auto copy = rt;
+	copy.temp_dir = rt.temp_dir / random_letters(16);
+	auto test_ident = ident_of(tested, copy);
+
 	try {
-		return run_test2(tested, variables, rt);
+		auto const start = std::chrono::steady_clock::now();
+		auto key = cache.key_for(tested, variables, rt);
+		if (use_cache && cache.passed(tested.filename, key)) {
+			co_return {.result = outcome::CACHED,
+			           .task_ident = std::move(test_ident),
+			           .index = tested.index,
+			           .filename = tested.filename,
+			           .cache_key = std::move(key)};
+		}
+
+		auto result = co_await run_test2(tested, variables, copy, test_ident);
+		result.elapsed = std::chrono::steady_clock::now() - start;
+		result.index = tested.index;
+		result.filename = tested.filename;
+		result.cache_key = std::move(key);
+		co_return result;
 	} catch (std::exception const& e) {
 		std::cerr << "exception: " << e.what() << '\n';
-		throw;
+		co_return {.result = outcome::FAILED,
+		           .task_ident = std::move(test_ident),
+		           .temp_dir = copy.temp_dir,
+		           .report = fmt::format("exception: {}", e.what()),
+		           .index = tested.index,
+		           .filename = tested.filename,
+		           .crashed = true};
 	} catch (...) {
-		throw;
+		co_return {.result = outcome::FAILED,
+		           .task_ident = std::move(test_ident),
+		           .temp_dir = copy.temp_dir,
+		           .report = "unknown exception"s,
+		           .index = tested.index,
+		           .filename = tested.filename,
+		           .crashed = true};
+	}
+}
+
+// Starts the test on the calling thread; whenever it waits for a process,
+// the thread is free to start, or continue, other tests.
+void publish_test(mt::mt_queue<test_results>& channel,
+                  testbed::test& tested,
+                  io::env_block const& variables,
+                  testbed::runtime const& rt,
+                  testbed::result_cache& cache,
+                  bool use_cache) {
+	mt::spawn(run_test(tested, variables, rt, cache, use_cache),
+	          [&channel](test_results&& result) {
+		          channel.push(std::move(result));
+	          });
+}
+
+static std::string seconds(testbed::milliseconds time) {
+	return fmt::format("{:.3f}s", static_cast<double>(time.count()) / 1000.0);
+}
+
+void print_plan(std::span<testbed::planned_test const> schedule,
+                size_t jobs,
+                testbed::resource_map const& capacities,
+                bool all_linear,
+                bool debug) {
+	size_t linear{}, measured{};
+	for (auto const& planned : schedule) {
+		if (all_linear || planned.item->linear) ++linear;
+		if (planned.measured) ++measured;
+	}
+
+	fmt::print("jobs:              {}\n", jobs);
+	fmt::print("tests:             {} parallel, {} linear ({} timed)\n",
+	           schedule.size() - linear, linear, measured);
+	for (auto const& [name, capacity] : capacities)
+		fmt::print("resource:          {} x{}\n", name, capacity);
+	fmt::print("total time:        {}\n", seconds(testbed::total(schedule)));
+	fmt::print(
+	    "expected makespan: {}\n",
+	    seconds(testbed::makespan(schedule, jobs, capacities, all_linear)));
+
+	if (!debug) return;
+
+	fmt::print("\n");
+	for (auto const& planned : schedule) {
+		std::string tokens{};
+		if (all_linear || planned.item->linear) tokens = " [linear]"s;
+		for (auto const& [name, count] : planned.item->resources)
+			tokens.append(fmt::format(" [{} x{}]", name, count));
+		fmt::print("  {:>10}{} {}{}\n", seconds(planned.estimate),
+		           planned.measured ? ' ' : '?', planned.item->name, tokens);
 	}
 }
 
-std::packaged_task<test_results()> package_test(
+static std::string describe(std::string_view label,
+                            testbed::bench_stats const& stats) {
+	return fmt::format(
+	    "  {:<5}min {:.2f} ms, median {:.2f} ms, p95 {:.2f} ms, "
+	    "stddev {:.2f} ms\n",
+	    label, stats.min, stats.median, stats.p95, stats.stddev);
+}
+
+// an exception ends up in the listing of a run without any capture, which
+// is reported as a failure
+static mt::co_task<testbed::test_bench_results> guarded_bench(
     testbed::test& tested,
-    std::map<std::string, std::string> const& variables,
-    testbed::runtime const& rt) {
-	return std::packaged_task<test_results()>{
-	    [&] { return run_test(tested, variables, rt); }};
+    io::env_block const& variables,
+    testbed::runtime const& rt,
+    size_t warmup,
+    size_t count) {
+	try {
+		co_return co_await tested.bench(variables, rt, warmup, count);
+	} catch (std::exception const& e) {
+		co_return {{.prepare = fmt::format("exception: {}\n", e.what())}};
+	} catch (...) {
+		co_return {{.prepare = "unknown exception\n"s}};
+	}
 }
 
-int tool(::args::args_view const& args) {
+static testbed::test_bench_results bench_test(
+    mt::stealing_pool& pool,
+    testbed::test& tested,
+    io::env_block const& variables,
+    testbed::runtime const& rt,
+    size_t warmup,
+    size_t count) {
+	std::promise<testbed::test_bench_results> done{};
+	auto result = done.get_future();
+	pool.push([&] {
+		mt::spawn(guarded_bench(tested, variables, rt, warmup, count),
+		          [&done](testbed::test_bench_results&& results) {
+			          done.set_value(std::move(results));
+		          });
+	});
+	return result.get();
+}
+
+// Runs the tests one after another, so they do not compete for the cores,
+// and compares their timings with the baseline kept in the dataset. Tests
+// missing from the baseline are added to it.
+static bool run_bench(mt::stealing_pool& pool,
+                      std::vector<testbed::test*> selected,
+                      io::env_block const& variables,
+                      testbed::runtime const& rt,
+                      fs::path const& test_set_dir,
+                      size_t warmup,
+                      size_t count,
+                      bool keep_dirs) {
+	testbed::bench_baseline baseline{test_set_dir};
+	baseline.load();
+
+	std::sort(selected.begin(), selected.end(),
+	          [](auto const* lhs, auto const* rhs) {
+		          return lhs->index < rhs->index;
+	          });
+
+	fmt::print("\nbenchmarking {} tests, {} runs each, after {} warmup...\n",
+	           selected.size(), count, warmup);
+
+	size_t failed{}, slower{}, added{};
+	for (auto* tested : selected) {
+		if (io::cancelled()) break;
+
+		auto copy = rt;
+		copy.temp_dir = rt.temp_dir / random_letters(16);
+		auto const test_ident = ident_of(*tested, copy);
+		auto results =
+		    bench_test(pool, *tested, variables, copy, warmup, count);
+
+		if (rt.debug) fmt::print("{}", results.prepare);
+		if (!keep_dirs) {
+			std::error_code ignore{};
+			fs::remove_all(copy.temp_dir, ignore);
+			fs::remove_all(copy.spill_dir(), ignore);
+		}
+
+		auto const& actual = results.capture;
+		auto const& expected = tested->expected;
+		if (!actual || results.samples.size() != count ||
+		    (expected && *actual != *expected &&
+		     tested->clip(*actual) != *expected)) {
+			if (!rt.debug) fmt::print("{}", results.prepare);
+			if (actual && expected)
+				fmt::print("{}\n", tested->report(tested->clip(*actual), copy));
+			fmt::print("{} {}FAILED{}\n", test_ident, color::failed,
+			           color::reset);
+			++failed;
+			continue;
+		}
+
+		auto const entry = testbed::bench_entry::of(results.samples);
+		fmt::print("{}\n{}{}", test_ident, describe("wall"sv, entry.wall),
+		           describe("cpu"sv, entry.cpu));
+
+		auto const* base = baseline.find(tested->filename);
+		if (!base) {
+			baseline.set(tested->filename, entry);
+			++added;
+			continue;
+		}
+
+		bool regressed{false};
+		for (auto const& [label, before, after] : {
+		         std::tuple{"wall"sv, &base->wall, &entry.wall},
+		         std::tuple{"cpu"sv, &base->cpu, &entry.cpu},
+		     }) {
+			auto const change = testbed::slower(*before, *after);
+			if (!change) continue;
+			regressed = true;
+			fmt::print(
+			    "  {}{} {:+.1f}% slower than the baseline: mean {:.2f} ms, "
+			    "was {:.2f} ms (t = {:.2f}){}\n",
+			    color::failed, label, change->ratio * 100, after->mean,
+			    before->mean, change->t, color::reset);
+		}
+		if (regressed) ++slower;
+	}
+
+	if (added) {
+		baseline.store();
+		fmt::print("\nadded {} {} to {}\n", added,
+		           added == 1 ? "test"sv : "tests"sv,
+		           shell::get_path(test_set_dir /
+		                           testbed::bench_baseline::filename));
+	}
+
+	fmt::print("\nFailed {}/{}\n", failed, selected.size());
+	fmt::print("Slower {}/{}\n", slower, selected.size());
+	return !failed && !slower;
+}
+
+// how long tests, which are still running after --fail-fast kicks in, get
+// between SIGTERM and SIGKILL
+static constexpr auto kill_grace = 2s;
+// how long --watch waits for the writes to stop, before starting a pass
+static constexpr auto watch_settle = 300ms;
+
+static bool is_within(fs::path const& path, fs::path const& dir) {
+	auto const relative = path.lexically_relative(dir);
+	return !relative.empty() && *relative.begin() != ".."sv;
+}
+
+// `restart` is set, if the session ended only to be started again, with
+// runner.chai loaded anew
+static int session(::args::args_view const& args, bool& restart) {
 #if 0
 	{
 		std::string dummy;
@@ -330,11 +708,22 @@ int tool(::args::args_view const& args) {
 	Chai::ProjectInfo info{};
 	fs::path test_dir, copy_dir, binary_dir, test_set_dir;
 	std::vector<size_t> run;
+	std::optional<size_t> jobs{};
 	std::string CMAKE_BUILD_TYPE;
-	bool debug{false}, nullify{false}, keep_dirs{false};
+	bool debug{false}, nullify{false}, keep_dirs{false}, plan{false};
+	bool auto_jobs{false}, no_cache{false};
+	bool last_failed{false}, failed_first{false}, watch{false};
+	bool sorted_summary{false}, fail_fast{false};
+	std::optional<unsigned> max_failures{}, timeout{};
+	std::optional<unsigned> bench{}, warmup{};
+	unsigned capture_limit{64};
 	std::optional<std::string> lang{};
 	std::optional<std::string> schema{};
+	std::optional<testbed::shard> shard{};
+	std::optional<std::string> shard_timings{};
 	{
+		std::optional<std::string> shard_spec{};
+		std::optional<std::string> jobs_spec{};
 		std::string preset;
 		std::string tests;
 
@@ -361,6 +750,83 @@ int tool(::args::args_view const& args) {
 		        "point to directory with the JSON test cases; "
 		        "test cases are enumerated recursively");
 		p.arg(run, "run").meta("ID").opt().help("filter the tests to run");
+		p.arg(jobs_spec, "j", "jobs")
+		    .meta("N|auto")
+		    .opt()
+		    .help(
+		        "run N tests in parallel, independent of the number of "
+		        "threads; defaults to the number of CPU cores; with `auto`, "
+		        "the number follows the load of the machine");
+		p.set<std::true_type>(fail_fast, "fail-fast")
+		    .opt()
+		    .help(
+		        "stop after the first failed test, killing the tests still "
+		        "running and cancelling the ones not started yet");
+		p.arg(max_failures, "max-failures")
+		    .meta("N")
+		    .opt()
+		    .help("same as --fail-fast, but stop after N failed tests");
+		p.set<std::true_type>(last_failed, "last-failed")
+		    .opt()
+		    .help("run only the tests, which failed in the previous run");
+		p.set<std::true_type>(failed_first, "failed-first")
+		    .opt()
+		    .help(
+		        "start the tests, which failed in the previous run, before "
+		        "all the others");
+		p.set<std::true_type>(watch, "watch")
+		    .opt()
+		    .help(
+		        "stay resident and run the tests again, whenever the test "
+		        "files, the build output or runner.chai change");
+		p.set<std::true_type>(no_cache, "no-cache")
+		    .opt()
+		    .help(
+		        "run every test, even if it passed before and none of its "
+		        "inputs changed since");
+		p.arg(shard_spec, "shard")
+		    .meta("I/N")
+		    .opt()
+		    .help(
+		        "run only the I-th of N parts of the suite; tests are split "
+		        "by a hash of their path");
+		p.arg(shard_timings, "shard-timings")
+		    .meta("FILE")
+		    .opt()
+		    .help(
+		        "split the --shard parts by the durations recorded in FILE, "
+		        "a history.json shared by all the machines");
+		p.arg(timeout, "timeout")
+		    .meta("SECONDS")
+		    .opt()
+		    .help(
+		        "kill any test phase running longer than SECONDS; tests may "
+		        "still set their own \"timeout\"");
+		p.arg(capture_limit, "capture-limit")
+		    .meta("MiB")
+		    .opt()
+		    .help(
+		        "keep at most MiB of each output stream in memory, the rest "
+		        "goes to a file in the test's temp directory; 0 keeps all, "
+		        "defaults to 64");
+		p.arg(bench, "bench")
+		    .meta("N")
+		    .opt()
+		    .help(
+		        "run each test N times, one test at a time, and compare the "
+		        "timings with the baseline kept in the dataset; tests not "
+		        "in the baseline are added to it");
+		p.arg(warmup, "warmup")
+		    .meta("K")
+		    .opt()
+		    .help(
+		        "with --bench, run each test K more times before measuring; "
+		        "defaults to 1");
+		p.set<std::true_type>(plan, "plan")
+		    .opt()
+		    .help(
+		        "print the expected makespan for the chosen number of jobs "
+		        "and exit without running the tests");
 		p.set<std::true_type>(debug, "debug")
 		    .opt()
 		    .help("print output even for successful tests");
@@ -371,6 +837,11 @@ int tool(::args::args_view const& args) {
 		    .meta("ID")
 		    .opt()
 		    .help("change language for nullified tests");
+		p.set<std::true_type>(sorted_summary, "sorted-summary")
+		    .opt()
+		    .help(
+		        "list all results again, ordered by test number, after the "
+		        "run; results are printed in order of completion");
 		p.set<std::true_type>(keep_dirs, "keep-dirs")
 		    .opt()
 		    .help("keep directories created during this run");
@@ -380,6 +851,36 @@ int tool(::args::args_view const& args) {
 		    .help("update the \"$schema\" in files");
 		p.parse();
 
+		if (jobs_spec) {
+			size_t value{};
+			auto const first = jobs_spec->data();
+			auto const last = first + jobs_spec->size();
+			auto const [ptr, ec] = std::from_chars(first, last, value);
+			if (*jobs_spec == "auto"sv) {
+				auto_jobs = true;
+			} else if (ec == std::errc{} && ptr == last && value) {
+				jobs = value;
+			} else {
+				p.error(fmt::format(
+				    "--jobs expects a positive number or `auto`; got `{}`",
+				    *jobs_spec));
+			}
+		}
+
+		if (shard_spec) {
+			shard = testbed::shard::parse(*shard_spec);
+			if (!shard) {
+				p.error(fmt::format(
+				    "--shard expects I/N, with I between 1 and N; got `{}`",
+				    *shard_spec));
+			}
+		} else if (shard_timings) {
+			p.error("--shard-timings needs --shard");
+		}
+
+		if (bench && !*bench) p.error("--bench expects a positive number");
+		if (warmup && !bench) p.error("--warmup needs --bench");
+
 		info = chai.project();
 		test_dir = fs::weakly_canonical(info.datasets_dir);
 		copy_dir = fs::weakly_canonical(u8"build/.json-runner"sv);
@@ -434,131 +935,381 @@ int tool(::args::args_view const& args) {
 		return 1;
 	}
 
-	std::vector<testbed::test> tests{};
-	size_t unfiltered_count{};
-
-	{
-		fs::recursive_directory_iterator dir{test_set_dir};
-		for (auto const& entry : dir) {
-			if (entry.path().extension() != ".json"sv) continue;
-			++unfiltered_count;
-			if (!run.empty() && std::find(run.begin(), run.end(),
-			                              unfiltered_count) == run.end())
-				continue;
-			auto test =
-			    testbed::test::load(entry.path(), unfiltered_count, schema);
-			if (!test.ok) continue;
-			if (nullify) {
-				test.nullify(lang);
-				continue;
-			}
-			tests.push_back(std::move(test));
-		}
-		if (nullify) return 0;
-	}
-
-	if (tests.empty()) {
-		fmt::print(stderr, "No tests to run.\n");
-		return 0;
+	size_t const cores = std::max(std::thread::hardware_concurrency(), 1u);
+	size_t const job_count = jobs ? *jobs : cores;
+	if (auto_jobs && !io::sample_load()) {
+		fmt::print(stderr,
+		           "warning: no load statistics on this system, "
+		           "running {} jobs\n",
+		           job_count);
+		auto_jobs = false;
 	}
+	unsigned const failure_limit =
+	    max_failures ? *max_failures : fail_fast ? 1u : 0u;
+	// where tests wait for their processes without holding a thread, more
+	// jobs than cores do not need more threads; elsewhere, each running
+	// job keeps one
+	mt::stealing_pool pool{io::runs_async() ? std::min(job_count, cores)
+	                                        : job_count};
 
 	auto variables = shell::get_env();
-	testbed::runtime rt{.target{target},
-	                    .build_dir = binary_dir,
-	                    .temp_dir = fs::canonical(fs::temp_directory_path()) /
-	                                "json-test-runner",
-	                    .version = cmake::get_project().ver(),
-	                    .counter_total = unfiltered_count,
-	                    .handlers = info.handlers(),
-	                    .variables = &variables,
-	                    .chai_variables = &info.environment,
-	                    .common_patches = &info.common_patches,
-	                    .debug = debug};
-	auto ec = install(copy_dir, binary_dir, CMAKE_BUILD_TYPE, rt,
-	                  info.install_components, info.installer);
-	if (ec) {
-		std::cerr << "error: " << ec.value() << ", " << ec.message() << '\n';
-		return 1;
-	}
-
-	size_t label_size = 10;
-	for (auto const& [var, _] : info.environment) {
-		auto const len = var.size() + 1;
-		if (len > label_size) label_size = len;
-	}
-	auto const mk_label = [label_size](std::string_view label,
-	                                   std::string_view prefix = {}) {
-		return fmt::format("{}{}:{:{}}", prefix, label, ' ',
-		                   label_size + 1 - (label.size() + prefix.size()));
-	};
-	fmt::print("{}{} {}\n", mk_label("target"sv), shell::get_path(rt.target),
-	           rt.version);
-	fmt::print("{}{}\n", mk_label("tests"sv), shell::get_path(test_set_dir));
-	for (auto const& [env, var] : info.environment)
-		fmt::print("{}{}\n", mk_label(env, "$"sv), var);
-	fmt::print("{}{}\n", mk_label("$INST"sv),
-	           shell::get_path(rt.rt_target.parent_path().parent_path()));
-	fmt::print("{}{}\n", mk_label("$TMP"sv), shell::get_path(rt.temp_dir));
-	// fmt::print("{}{}\n", mk_label("JSON horiz"sv),
-	// testbed::test::HORIZ_SPACE);
-	fmt::print("common patches:\n");
-	for (auto const& [expr, replacement] : info.common_patches)
-		fmt::print("  {}: {},\n", repr(expr), repr(replacement));
-
-	::counters counters{};
 
 	auto const RUN_LINEAR = [&variables] {
 		auto it = variables.find("RUN_LINEAR");
 		return it != variables.end() && it->second != "0"sv;
 	}();
 
-	if (!RUN_LINEAR) {
-		mt::thread_pool pool{};
-		std::vector<std::future<test_results>> results{};
+	testbed::history history{copy_dir / testbed::history::dirname, test_dir};
+	history.load();
 
-		results.reserve(tests.size());
+	testbed::result_cache cache{copy_dir / testbed::history::dirname,
+	                            test_dir};
+	cache.load();
 
-		fmt::print("\nrunning parallel....\n");
+	std::unique_ptr<io::watcher> files{};
+	if (watch && !plan && !nullify) {
+		files = io::watcher::create();
+		if (!files) {
+			fmt::print(stderr, "error: --watch is not supported here\n");
+			return 1;
+		}
+		// before the first pass, so the edits made during it are seen
+		files->add_tree(test_dir);
+		files->add_tree(binary_dir / "bin"sv);
+		if (fs::is_directory(binary_dir / "mocks"sv))
+			files->add_tree(binary_dir / "mocks"sv);
+		files->add_file(fs::absolute("runner.chai"sv));
+	}
 
+	std::optional<testbed::runtime> runtime{};
+	bool needs_install{true};
+	bool first_pass{true};
+
+	// One pass over the suite; with --watch, `only` narrows it down to the
+	// test files changed since the previous pass.
+	auto const run_suite = [&](std::set<fs::path> const* only) -> int {
+		std::vector<fs::path> filenames{};
+		std::vector<testbed::test> tests{};
+		try {
+			filenames = testbed::discover(pool, test_set_dir);
+			tests = testbed::load(pool, filenames,
+			                      {.run = run,
+			                       .schema = schema,
+			                       .nullify = nullify,
+			                       .lang = lang});
+		} catch (std::exception const& e) {
+			fmt::print(stderr, "error: {}\n", e.what());
+			return 1;
+		}
+		size_t const unfiltered_count = filenames.size();
+		if (nullify) return 0;
+
+		if (tests.empty()) {
+			fmt::print(stderr, "No tests to run.\n");
+			return 0;
+		}
+
+		std::vector<testbed::test*> selected{};
+		selected.reserve(tests.size());
 		for (auto& test : tests) {
-			if (test.linear) continue;
-			auto task = package_test(test, variables, rt);
-			results.emplace_back(task.get_future());
-			pool.push(std::move(task));
+			if (only ? !only->contains(test.filename.lexically_normal())
+			         : last_failed && !history.failed(test.filename))
+				continue;
+			selected.push_back(&test);
+		}
+
+		// with --watch, a changed file might not be a test at all
+		if (only && selected.empty()) return 0;
+		if (last_failed && selected.empty()) {
+			fmt::print(stderr, "No test failed in the previous run.\n");
+			return 0;
+		}
+
+		if (shard) {
+			if (shard_timings) {
+				auto timings = testbed::history::from_file(
+				    shell::make_u8path(*shard_timings), test_dir);
+				timings.load();
+				selected = testbed::balanced_shard(selected, *shard, timings);
+			} else {
+				selected = testbed::hashed_shard(selected, *shard, history);
+			}
+
+			if (selected.empty()) {
+				fmt::print(stderr, "No tests to run in shard {}/{}.\n",
+				           shard->index, shard->count);
+				return 0;
+			}
+		}
+
+		auto schedule = testbed::longest_first(selected, history);
+		if (failed_first) testbed::failed_first(schedule, history);
+
+		if (plan) {
+			print_plan(schedule, job_count, info.resources, RUN_LINEAR, debug);
+			return 0;
+		}
+
+		if (!runtime) {
+			auto const cli_timeouts =
+			    timeout ? testbed::timeouts::all(std::chrono::seconds{*timeout})
+			            : testbed::timeouts{};
+			runtime.emplace(testbed::runtime{
+			    .target{target},
+			    .build_dir = binary_dir,
+			    .temp_dir = fs::canonical(fs::temp_directory_path()) /
+			                "json-test-runner",
+			    .version = cmake::get_project().ver(),
+			    .handlers = info.handlers(),
+			    .variables = &variables,
+			    .chai_variables = &info.environment,
+			    .common_patches = &info.common_patches,
+			    .timeout = cli_timeouts.with_defaults(info.timeout),
+			    .capture_limit = size_t{capture_limit} * 1024 * 1024,
+			    .debug = debug});
+		}
+		auto& rt = *runtime;
+		rt.set_counter_total(unfiltered_count);
+
+		if (needs_install) {
+			auto ec = install(copy_dir, binary_dir, CMAKE_BUILD_TYPE, rt,
+			                  info.install_components, info.installer);
+			if (ec) {
+				std::cerr << "error: " << ec.value() << ", " << ec.message()
+				          << '\n';
+				return 1;
+			}
+			needs_install = false;
+		}
+
+		if (first_pass) {
+			first_pass = false;
+			size_t label_size = 10;
+			for (auto const& [var, _] : info.environment) {
+				auto const len = var.size() + 1;
+				if (len > label_size) label_size = len;
+			}
+			auto const mk_label = [label_size](std::string_view label,
+			                                   std::string_view prefix = {}) {
+				return fmt::format(
+				    "{}{}:{:{}}", prefix, label, ' ',
+				    label_size + 1 - (label.size() + prefix.size()));
+			};
+			fmt::print("{}{} {}\n", mk_label("target"sv),
+			           shell::get_path(rt.target), rt.version);
+			fmt::print("{}{}\n", mk_label("tests"sv),
+			           shell::get_path(test_set_dir));
+			if (shard) {
+				fmt::print("{}{}/{}, {} of {} tests\n", mk_label("shard"sv),
+				           shard->index, shard->count, selected.size(),
+				           tests.size());
+			}
+			for (auto const& [env, var] : info.environment)
+				fmt::print("{}{}\n", mk_label(env, "$"sv), var);
+			fmt::print(
+			    "{}{}\n", mk_label("$INST"sv),
+			    shell::get_path(rt.rt_target.parent_path().parent_path()));
+			fmt::print("{}{}\n", mk_label("$TMP"sv),
+			           shell::get_path(rt.temp_dir));
+			// fmt::print("{}{}\n", mk_label("JSON horiz"sv),
+			// testbed::test::HORIZ_SPACE);
+			fmt::print("common patches:\n");
+			for (auto const& [expr, replacement] : info.common_patches)
+				fmt::print("  {}: {},\n", repr(expr), repr(replacement));
 		}
 
-		for (auto& future : results) {
-			auto results = future.get();
-			counters.report(results.result, results.task_ident,
+		::counters counters{sorted_summary};
+
+		// the target, or the mocks, might have changed since the last pass
+		cache.prepare(rt, "runner.chai"sv, version::ui);
+
+		// serialized once; the tests only add their own changes to it
+		io::env_block const environment{variables};
+
+		if (bench) {
+			return run_bench(pool, selected, environment, rt, test_set_dir,
+			                 warmup.value_or(1), *bench, keep_dirs)
+			           ? 0
+			           : 1;
+		}
+
+		auto const complete = [&](test_results const& results) {
+			switch (results.result) {
+				case outcome::SKIPPED:
+				case outcome::CANCELLED:
+				case outcome::CACHED:
+					break;
+				default:
+					if (results.crashed) break;
+					history.set_duration(
+					    results.filename,
+					    std::chrono::duration_cast<testbed::milliseconds>(
+					        results.elapsed));
+			}
+			switch (results.result) {
+				case outcome::FAILED:
+				case outcome::CLIP_FAILED:
+				case outcome::PERF_FAILED:
+				case outcome::TIMEOUT:
+					history.set_failed(results.filename, true);
+					break;
+				case outcome::OK:
+				case outcome::SAVED:
+				case outcome::CACHED:
+					history.set_failed(results.filename, false);
+					break;
+				default:
+					break;
+			}
+			if (results.rusage)
+				history.set_rusage(results.filename, *results.rusage);
+			if (results.result == outcome::OK)
+				cache.set_passed(results.filename, results.cache_key);
+			else if (results.result != outcome::CACHED)
+				cache.forget(results.filename);
+
+			counters.report(results.index, results.result, results.task_ident,
 			                results.report ? *results.report : ""sv,
 			                results.prepare, rt.debug);
+			if (results.temp_dir.empty()) return;
 			if (!keep_dirs) {
 				std::error_code ignore{};
 				fs::remove_all(results.temp_dir, ignore);
+				fs::remove_all(
+				    testbed::runtime::spill_dir_for(results.temp_dir), ignore);
 			} else {
 				fmt::print("keeping {}\n", shell::get_u8path(results.temp_dir));
 			}
+		};
+
+		{
+			mt::mt_queue<test_results> channel{};
+
+			fmt::print("\nrunning {} tests....\n", selected.size());
+
+			testbed::dispatcher queue{schedule, job_count, info.resources,
+			                          RUN_LINEAR};
+			size_t started{};
+			auto const start_next = [&] {
+				for (auto const& planned : queue.start_next()) {
+					++started;
+					pool.push([&, tested = planned.item] {
+						publish_test(channel, *tested, environment, rt, cache,
+						             !no_cache);
+					});
+				}
+			};
+
+			bool cancelled{false};
+			std::optional<testbed::load_control> control{};
+			if (auto_jobs) {
+				control.emplace(job_count);
+				control->update(queue.running());
+				fmt::print("{}jobs: {} (auto){}\n", color::skipped,
+				           control->jobs(), color::reset);
+			}
+			auto const adjust = [&] {
+				auto const before = queue.jobs();
+				if (!control->update(queue.running())) return;
+				fmt::print("{}jobs: {} -> {} ({}){}\n", color::skipped, before,
+				           control->jobs(), control->describe(), color::reset);
+				queue.jobs(control->jobs());
+				if (!cancelled) start_next();
+			};
+
+			start_next();
+			for (size_t count = 0; count < started;) {
+				if (control && control->due()) adjust();
+
+				test_results results{};
+				if (!control) {
+					channel.wait_and_pop(results);
+				} else if (!channel.wait_and_pop(results,
+				                                 control->next_sample())) {
+					continue;
+				}
+				++count;
+				queue.finished(results.index);
+				complete(results);
+
+				if (!cancelled && failure_limit &&
+				    counters.failed() >= failure_limit) {
+					cancelled = true;
+					fmt::print("\nstopping after {} failed {}...\n",
+					           counters.failed(),
+					           counters.failed() == 1 ? "test"sv : "tests"sv);
+					io::cancel_all(kill_grace);
+				}
+
+				if (!cancelled) start_next();
+			}
+
+			for (auto const& planned : queue.cancel()) {
+				counters.report(planned.item->index, outcome::CANCELLED,
+				                ident_of(*planned.item, rt), {}, {}, false);
+			}
 		}
-	}
 
-	fmt::print("\nrunning linear....\n");
+		history.store();
+		cache.store();
+
+		if (rt.debug) {
+			auto const lookups = io::program_cache::instance().counters();
+			auto const total = lookups.hits + lookups.misses;
+			fmt::print(
+			    "program lookups: {} cached, {} on PATH ({:.1f}% hits)\n",
+			    lookups.hits, lookups.misses,
+			    total ? 100.0 * static_cast<double>(lookups.hits) /
+			                static_cast<double>(total)
+			          : 0.0);
+		}
 
-	for (auto& test : tests) {
-		if (!(RUN_LINEAR || test.linear)) continue;
+		return counters.summary(selected.size()) ? 0 : 1;
+	};
 
-		auto results = run_test(test, variables, rt);
-		counters.report(results.result, results.task_ident,
-		                results.report ? *results.report : ""sv,
-		                results.prepare, rt.debug);
-		if (!keep_dirs) {
-			std::error_code ignore{};
-			fs::remove_all(results.temp_dir, ignore);
-		} else {
-			fmt::print("keeping {}\n", shell::get_u8path(results.temp_dir));
+	auto result = run_suite(nullptr);
+	if (!files) return result;
+
+	auto const script = fs::absolute("runner.chai"sv);
+	while (true) {
+		fmt::print("\nwatching for changes...\n");
+		auto const changes = files->wait(watch_settle);
+		if (changes.empty()) return result;
+
+		bool everything{false};
+		std::set<fs::path> only{};
+		for (auto const& path : changes) {
+			if (path == script) {
+				// the script state cannot be reloaded in place
+				fmt::print("runner.chai changed, restarting...\n");
+				restart = true;
+				return result;
+			}
+			if (is_within(path, binary_dir / "bin"sv)) {
+				needs_install = true;
+				everything = true;
+			} else if (path.extension() == ".json"sv) {
+				only.insert(path.lexically_normal());
+			} else {
+				// a mock, or a fixture; the result cache skips the tests,
+				// which do not use it
+				everything = true;
+			}
 		}
-	}
 
-	if (!counters.summary(tests.size())) return 1;
+		io::resume();
+		result = run_suite(everything ? nullptr : &only);
+	}
+}
 
-	return 0;
+int tool(::args::args_view const& args) {
+	io::cancel_on_signals(kill_grace);
+
+	bool restart{false};
+	int result{};
+	do {
+		restart = false;
+		result = session(args, restart);
+	} while (restart);
+	return result;
 }
@@ -0,0 +1,157 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "io/run.hh"
+#include "mt/stealing_pool.hh"
+
+namespace mt {
+	template <typename T>
+	class co_task;
+
+	namespace detail {
+		struct promise_base {
+			std::coroutine_handle<> continuation{};
+			std::exception_ptr error{};
+
+			struct final_awaiter {
+				bool await_ready() const noexcept { return false; }
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(
+				    std::coroutine_handle<Promise> self) noexcept {
+					auto next = self.promise().continuation;
+					return next ? next : std::noop_coroutine();
+				}
+				void await_resume() const noexcept {}
+			};
+
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			final_awaiter final_suspend() noexcept { return {}; }
+			void unhandled_exception() noexcept {
+				error = std::current_exception();
+			}
+			void rethrow() const {
+				if (error) std::rethrow_exception(error);
+			}
+		};
+
+		template <typename T>
+		struct promise : promise_base {
+			std::optional<T> value{};
+
+			co_task<T> get_return_object() noexcept;
+			void return_value(T result) { value.emplace(std::move(result)); }
+			T take() {
+				rethrow();
+				return std::move(*value);
+			}
+		};
+
+		template <>
+		struct promise<void> : promise_base {
+			co_task<void> get_return_object() noexcept;
+			void return_void() noexcept {}
+			void take() { rethrow(); }
+		};
+
+		struct detached {
+			struct promise_type {
+				detached get_return_object() noexcept { return {}; }
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
+				void return_void() noexcept {}
+				void unhandled_exception() noexcept { std::terminate(); }
+			};
+		};
+	}  // namespace detail
+
+	// Lazy coroutine: it starts, when first co_awaited, and once it is
+	// done, the awaiting coroutine continues on the same thread.
+	template <typename T = void>
+	class [[nodiscard]] co_task {
+	public:
+		using promise_type = detail::promise<T>;
+		using handle = std::coroutine_handle<promise_type>;
+
+		explicit co_task(handle coro) noexcept : coro_{coro} {}
+		co_task(co_task&& other) noexcept
+		    : coro_{std::exchange(other.coro_, {})} {}
+		co_task& operator=(co_task&& other) noexcept {
+			if (this != &other) {
+				if (coro_) coro_.destroy();
+				coro_ = std::exchange(other.coro_, {});
+			}
+			return *this;
+		}
+		~co_task() {
+			if (coro_) coro_.destroy();
+		}
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(
+		    std::coroutine_handle<> awaiting) noexcept {
+			coro_.promise().continuation = awaiting;
+			return coro_;
+		}
+		T await_resume() { return coro_.promise().take(); }
+
+	private:
+		handle coro_{};
+	};
+
+	namespace detail {
+		template <typename T>
+		co_task<T> promise<T>::get_return_object() noexcept {
+			return co_task<T>{co_task<T>::handle::from_promise(*this)};
+		}
+
+		inline co_task<void> promise<void>::get_return_object() noexcept {
+			return co_task<void>{co_task<void>::handle::from_promise(*this)};
+		}
+	}  // namespace detail
+
+	// Runs the task on the calling thread, until its first suspension,
+	// and hands the result over to `on_done`. The task must not throw.
+	template <typename T, typename Callback>
+	detail::detached spawn(co_task<T> task, Callback on_done) {
+		if constexpr (std::is_void_v<T>) {
+			co_await std::move(task);
+			on_done();
+		} else {
+			on_done(co_await std::move(task));
+		}
+	}
+
+	// Starts the process with io::run_async() and suspends until it is
+	// gone, so no thread is blocked in the meantime. The coroutine then
+	// continues on the pool it was suspended on.
+	class process {
+	public:
+		explicit process(io::run_opts const& options) : options_{options} {}
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> coro) {
+			auto const pool = stealing_pool::current();
+			// `this` lives in the coroutine frame; nothing may touch it
+			// after the coroutine is resumed
+			io::run_async(options_, [this, coro, pool](io::capture&& result) {
+				result_ = std::move(result);
+				if (pool)
+					pool->push([coro] { coro.resume(); });
+				else
+					coro.resume();
+			});
+		}
+		io::capture await_resume() { return std::move(result_); }
+
+	private:
+		io::run_opts const& options_;
+		io::capture result_{};
+	};
+}  // namespace mt
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -51,6 +52,14 @@ namespace mt {
 			cv_.notify_one();
 		}
 
+		void wait_and_pop(Element& result) {
+			std::unique_lock lock{m_};
+			cv_.wait(lock, [this] { return !items_.empty(); });
+			result = std::move(items_.front());
+			items_.pop();
+			++popped_;
+		}
+
 		bool wait_and_pop(Element& result, std::stop_token tok) {
 			std::unique_lock lock{m_};
 			cv_.wait(lock, [this, &tok] {
@@ -64,6 +73,19 @@ namespace mt {
 			return !tok.stop_requested();
 		}
 
+		template <typename Clock, typename Duration>
+		bool wait_and_pop(Element& result,
+		                  std::chrono::time_point<Clock, Duration> until) {
+			std::unique_lock lock{m_};
+			if (!cv_.wait_until(lock, until,
+			                    [this] { return !items_.empty(); }))
+				return false;
+			result = std::move(items_.front());
+			items_.pop();
+			++popped_;
+			return true;
+		}
+
 	private:
 		mutable std::mutex m_{};
 		std::condition_variable cv_{};
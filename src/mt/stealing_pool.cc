@@ -0,0 +1,110 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "mt/stealing_pool.hh"
+
+namespace mt {
+	namespace {
+		thread_local stealing_pool* current_pool{nullptr};
+		thread_local size_t current_index{};
+	}  // namespace
+
+	void stealing_pool::worker::push(task&& job) {
+		std::lock_guard lock{m};
+		items.push_back(std::move(job));
+	}
+
+	bool stealing_pool::worker::pop(task& result) {
+		std::lock_guard lock{m};
+		if (items.empty()) return false;
+		result = std::move(items.front());
+		items.pop_front();
+		return true;
+	}
+
+	bool stealing_pool::worker::steal(task& result, bool blocking) {
+		std::unique_lock lock{m, std::defer_lock};
+		if (blocking)
+			lock.lock();
+		else if (!lock.try_lock())
+			return false;
+		if (items.empty()) return false;
+		result = std::move(items.back());
+		items.pop_back();
+		return true;
+	}
+
+	stealing_pool::stealing_pool(size_t size) {
+		if (!size) size = 1;
+		workers_.reserve(size);
+		for (size_t index = 0; index < size; ++index)
+			workers_.push_back(std::make_unique<worker>());
+
+		threads_.reserve(size);
+		for (size_t index = 0; index < size; ++index)
+			threads_.push_back(std::jthread{
+			    [this, index](std::stop_token tok) { thread_proc(tok, index); }});
+	}
+
+	stealing_pool::~stealing_pool() {
+		for (auto& thread : threads_)
+			thread.request_stop();
+		signal_.fetch_add(1, std::memory_order_release);
+		signal_.notify_all();
+		threads_.clear();
+	}
+
+	stealing_pool* stealing_pool::current() noexcept { return current_pool; }
+
+	void stealing_pool::push(task&& job) {
+		auto const index =
+		    current_pool == this
+		        ? current_index
+		        : round_robin_.fetch_add(1, std::memory_order_relaxed) %
+		              workers_.size();
+		workers_[index]->push(std::move(job));
+		signal_.fetch_add(1, std::memory_order_release);
+		signal_.notify_one();
+	}
+
+	void stealing_pool::thread_proc(std::stop_token tok, size_t index) {
+		current_pool = this;
+		current_index = index;
+
+		std::minstd_rand rng{static_cast<std::minstd_rand::result_type>(
+		    std::hash<std::thread::id>{}(std::this_thread::get_id()))};
+
+		while (!tok.stop_requested()) {
+			auto const seen = signal_.load(std::memory_order_acquire);
+			task job{};
+			if (next(index, job, rng)) {
+				job();
+				continue;
+			}
+			if (tok.stop_requested()) break;
+			signal_.wait(seen, std::memory_order_acquire);
+		}
+
+		current_pool = nullptr;
+	}
+
+	bool stealing_pool::next(size_t index,
+	                         task& result,
+	                         std::minstd_rand& rng) {
+		if (workers_[index]->pop(result)) return true;
+
+		auto const count = workers_.size();
+		if (count < 2) return false;
+
+		// two rounds: the first one skips victims busy with their own lock
+		auto const start = static_cast<size_t>(rng()) % count;
+		for (int round = 0; round < 2; ++round) {
+			for (size_t offset = 0; offset < count; ++offset) {
+				auto const victim = (start + offset) % count;
+				if (victim == index) continue;
+				if (workers_[victim]->steal(result, round != 0)) return true;
+			}
+		}
+		return false;
+	}
+}  // namespace mt
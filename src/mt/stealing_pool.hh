@@ -0,0 +1,54 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace mt {
+	using task = std::move_only_function<void()>;
+
+	// Each worker owns a deque guarded by its own mutex. Tasks pushed from
+	// a worker stay with that worker, tasks pushed from outside are dealt
+	// round-robin. An idle worker takes from the front of its own deque
+	// and, when that is empty, steals from the back of a random victim.
+	class stealing_pool {
+	public:
+		stealing_pool(size_t size = std::thread::hardware_concurrency());
+		~stealing_pool();
+		stealing_pool(stealing_pool const&) = delete;
+		stealing_pool& operator=(stealing_pool const&) = delete;
+
+		void push(task&& job);
+		size_t size() const noexcept { return workers_.size(); }
+
+		// the pool running the calling thread, if any
+		static stealing_pool* current() noexcept;
+
+	private:
+		struct worker {
+			std::mutex m{};
+			std::deque<task> items{};
+
+			void push(task&& job);
+			bool pop(task& result);
+			bool steal(task& result, bool blocking);
+		};
+
+		void thread_proc(std::stop_token tok, size_t index);
+		bool next(size_t index, task& result, std::minstd_rand& rng);
+
+		std::vector<std::unique_ptr<worker>> workers_{};
+		std::atomic<size_t> round_robin_{};
+		std::atomic<unsigned> signal_{};
+		std::vector<std::jthread> threads_{};
+	};
+}  // namespace mt
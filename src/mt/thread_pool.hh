@@ -3,24 +3,44 @@
 
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <functional>
 #include <future>
 #include <optional>
 #include <thread>
 #include <vector>
+#include "io/resource_usage.hh"
 #include "mt/queue.hh"
 
 namespace fs = std::filesystem;
 
-enum class outcome { OK, SKIPPED, SAVED, FAILED, CLIP_FAILED };
+enum class outcome {
+	OK,
+	SKIPPED,
+	SAVED,
+	FAILED,
+	CLIP_FAILED,
+	PERF_FAILED,
+	CANCELLED,
+	TIMEOUT,
+	CACHED
+};
 
 struct test_results {
-	outcome result;
-	std::string task_ident;
-	fs::path temp_dir;
-	std::string prepare;
+	outcome result{outcome::OK};
+	std::string task_ident{};
+	fs::path temp_dir{};
+	std::string prepare{};
 	std::optional<std::string> report{std::nullopt};
+	std::chrono::steady_clock::duration elapsed{};
+	size_t index{};
+	fs::path filename{};
+	std::string cache_key{};
+	// unset, if the tested call did not run
+	std::optional<io::resource_usage> rusage{};
+	// stopped by an exception; there is no duration worth remembering
+	bool crashed{false};
 };
 
 namespace mt {
@@ -0,0 +1,105 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "io/load.hh"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include "io/file.hh"
+
+using namespace std::literals;
+
+namespace io {
+	namespace {
+		std::string_view next_field(std::string_view& line) {
+			auto const start = line.find_first_not_of(' ');
+			if (start == std::string_view::npos) {
+				line = {};
+				return {};
+			}
+			line = line.substr(start);
+			auto const end = std::min(line.find(' '), line.size());
+			auto const result = line.substr(0, end);
+			line = line.substr(end);
+			return result;
+		}
+
+		template <typename Number>
+		bool parse(std::string_view field, Number& result) {
+			auto const end = field.data() + field.size();
+			auto const [ptr, ec] = std::from_chars(field.data(), end, result);
+			return ec == std::errc{} && ptr == end;
+		}
+
+		// cpu  user nice system idle iowait irq softirq steal ...
+		bool cpu_times(load_sample& sample) {
+			auto const line = io::file{"/proc/stat"}.read_line();
+			std::string_view view{line};
+			if (next_field(view) != "cpu"sv) return false;
+
+			std::array<std::uint64_t, 8> ticks{};
+			for (auto& value : ticks) {
+				auto const field = next_field(view);
+				// older kernels stop after iowait or softirq
+				if (field.empty()) break;
+				if (!parse(field, value)) return false;
+			}
+
+			auto const [user, nice, system, idle, iowait, irq, softirq,
+			            steal] = ticks;
+			sample.busy = user + nice + system + irq + softirq + steal;
+			sample.idle = idle;
+			sample.iowait = iowait;
+			return true;
+		}
+
+		// 0.20 0.18 0.12 1/80 11206
+		std::optional<unsigned> runnable() {
+			auto const line = io::file{"/proc/loadavg"}.read_line();
+			std::string_view view{line};
+			for (int skip = 0; skip < 3; ++skip)
+				next_field(view);
+
+			auto const field = next_field(view);
+			auto const slash = field.find('/');
+			unsigned result{};
+			if (slash == std::string_view::npos ||
+			    !parse(field.substr(0, slash), result))
+				return std::nullopt;
+			// do not count the thread reading the file
+			return result ? result - 1 : result;
+		}
+
+		std::chrono::microseconds children_time() {
+			rusage usage{};
+			if (::getrusage(RUSAGE_CHILDREN, &usage)) return {};
+			auto const time = [](timeval const& tv) {
+				return std::chrono::seconds{tv.tv_sec} +
+				       std::chrono::microseconds{tv.tv_usec};
+			};
+			return time(usage.ru_utime) + time(usage.ru_stime);
+		}
+	}  // namespace
+
+	std::optional<load_sample> sample_load() {
+		load_sample result{.taken = std::chrono::steady_clock::now()};
+		if (!cpu_times(result)) return std::nullopt;
+		result.children = children_time();
+		result.runnable = runnable();
+		return result;
+	}
+}  // namespace io
+
+#else  // __linux__
+
+namespace io {
+	// no /proc/stat to read from
+	std::optional<load_sample> sample_load() { return std::nullopt; }
+}  // namespace io
+
+#endif  // __linux__
@@ -0,0 +1,306 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "posix/reactor.hh"
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <array>
+#include <climits>
+
+namespace io::posix {
+	namespace {
+		constexpr size_t BUFSIZE = 16384u;
+		constexpr int MAX_EVENTS = 64;
+
+		int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+			return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+			errno = ENOSYS;
+			return -1;
+#endif
+		}
+
+		void non_blocking(int fd) {
+			auto const flags = ::fcntl(fd, F_GETFL);
+			if (flags != -1) ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+		}
+	}  // namespace
+
+	bool reactor::watched::done() const noexcept {
+		return std::all_of(sources.begin(), sources.end(),
+		                   [](source const& src) { return src.fd == -1; });
+	}
+
+	reactor* reactor::instance() {
+		using pointer = std::unique_ptr<reactor>;
+		static pointer self = []() -> pointer {
+			// probe for pidfd_open with our own pid, it needs Linux 5.3
+			auto const probe = pidfd_open(::getpid());
+			if (probe == -1) return nullptr;
+			::close(probe);
+
+			auto const epoll = ::epoll_create1(EPOLL_CLOEXEC);
+			if (epoll == -1) return nullptr;
+			auto const wakeup = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			if (wakeup == -1) {
+				::close(epoll);
+				return nullptr;
+			}
+			return pointer{new reactor{epoll, wakeup}};
+		}();
+		return self.get();
+	}
+
+	reactor::reactor(int epoll, int wakeup) : epoll_{epoll}, wakeup_{wakeup} {
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.ptr = nullptr;
+		::epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &ev);
+
+		thread_ = std::jthread{[this](std::stop_token tok) { loop(tok); }};
+	}
+
+	reactor::~reactor() {
+		thread_.request_stop();
+		std::uint64_t one = 1;
+		[[maybe_unused]] auto ignore = ::write(wakeup_, &one, sizeof(one));
+		if (thread_.joinable()) thread_.join();
+
+		for (auto& [_, child] : children_) {
+			for (auto& src : child->sources) {
+				if (src.fd != -1) ::close(src.fd);
+			}
+		}
+		::close(wakeup_);
+		::close(epoll_);
+	}
+
+	bool reactor::watch(job& item) {
+		auto const pidfd = pidfd_open(item.pid);
+		if (pidfd == -1) return false;
+
+		auto child = std::make_unique<watched>();
+		child->pid = item.pid;
+		child->input_data = item.input_data;
+		child->deadline = item.deadline;
+		child->on_exit = std::move(item.on_exit);
+		if (item.spill) {
+			child->result.output = io::bounded_stream{*item.spill, "stdout"};
+			child->result.error = io::bounded_stream{*item.spill, "stderr"};
+		}
+
+		auto const fds = std::array{pidfd, item.input, item.output, item.error};
+		for (size_t index = 0; index < fds.size(); ++index) {
+			child->sources[index] = {
+			    .owner = child.get(),
+			    .type = static_cast<source::kind>(index),
+			    .fd = fds[index],
+			};
+		}
+		item.input = item.output = item.error = -1;
+
+		// nothing to write, the child should see the end of the input
+		if (child->input_data.empty() &&
+		    child->sources[source::input].fd != -1) {
+			::close(child->sources[source::input].fd);
+			child->sources[source::input].fd = -1;
+		}
+
+		std::lock_guard lock{m_};
+		for (auto& src : child->sources) {
+			if (src.fd == -1) continue;
+			if (src.type != source::exit) non_blocking(src.fd);
+
+			epoll_event ev{};
+			ev.events = src.type == source::input ? EPOLLOUT : EPOLLIN;
+			ev.data.ptr = &src;
+			::epoll_ctl(epoll_, EPOLL_CTL_ADD, src.fd, &ev);
+		}
+		children_[item.pid] = std::move(child);
+
+		if (item.deadline) {
+			// the loop might be sleeping past this deadline
+			std::uint64_t one = 1;
+			[[maybe_unused]] auto ignore = ::write(wakeup_, &one, sizeof(one));
+		}
+		return true;
+	}
+
+	void reactor::loop(std::stop_token tok) {
+		std::array<epoll_event, MAX_EVENTS> events{};
+		std::vector<std::unique_ptr<watched>> finished{};
+		auto timeout = -1;
+
+		while (!tok.stop_requested()) {
+			auto const count =
+			    ::epoll_wait(epoll_, events.data(), MAX_EVENTS, timeout);
+			if (count < 0 && errno != EINTR) break;
+
+			{
+				std::lock_guard lock{m_};
+				for (int index = 0; index < count; ++index) {
+					auto const& ev = events[static_cast<size_t>(index)];
+					if (!ev.data.ptr) {
+						std::uint64_t value{};
+						[[maybe_unused]] auto ignore =
+						    ::read(wakeup_, &value, sizeof(value));
+						continue;
+					}
+					on_event(*static_cast<source*>(ev.data.ptr), ev.events);
+				}
+
+				auto const now = clock::now();
+				for (auto it = children_.begin(); it != children_.end();) {
+					auto& child = *it->second;
+					// the group may outlive its leader and still hold the
+					// pipes open
+					if (child.deadline && *child.deadline <= now) {
+						child.deadline.reset();
+						child.result.timed_out = true;
+						::kill(-child.pid, SIGKILL);
+					}
+
+					if (child.done()) {
+						finished.push_back(std::move(it->second));
+						it = children_.erase(it);
+						continue;
+					}
+					++it;
+				}
+
+				timeout = next_timeout(now);
+			}
+
+			// outside of the lock, so that the callbacks may start new
+			// children
+			for (auto& child : finished)
+				child->on_exit(std::move(child->result));
+			finished.clear();
+		}
+	}
+
+	void reactor::on_event(source& src, std::uint32_t events) {
+		auto& child = *src.owner;
+
+		switch (src.type) {
+			case source::exit:
+				close_source(src);
+				return;
+
+			case source::input: {
+				if (events & (EPOLLERR | EPOLLHUP)) {
+					close_source(src);
+					return;
+				}
+				while (!child.input_data.empty()) {
+					auto const chunk =
+					    std::min(child.input_data.size(), BUFSIZE);
+					auto const actual = write_to_child(
+					    src.fd, child.input_data.data(), chunk);
+					if (actual < 0) {
+						if (errno == EAGAIN || errno == EINTR) return;
+						// EPIPE: the child is done reading, the rest of the
+						// input is dropped
+						break;
+					}
+					child.input_data =
+					    child.input_data.substr(static_cast<size_t>(actual));
+				}
+				close_source(src);
+				return;
+			}
+
+			case source::output:
+			case source::error: {
+				auto& bytes = src.type == source::output ? child.result.output
+				                                         : child.result.error;
+				char buffer[BUFSIZE];
+				while (true) {
+					auto const actual =
+					    ::read(src.fd, buffer, std::size(buffer));
+					if (actual < 0) {
+						if (errno == EINTR) continue;
+						if (errno == EAGAIN) return;
+						break;
+					}
+					if (actual == 0) break;
+					bytes.append(buffer, static_cast<size_t>(actual));
+				}
+				close_source(src);
+				return;
+			}
+		}
+	}
+
+	void reactor::close_source(source& src) {
+		::epoll_ctl(epoll_, EPOLL_CTL_DEL, src.fd, nullptr);
+		::close(src.fd);
+		src.fd = -1;
+	}
+
+	int reactor::next_timeout(clock::time_point now) {
+		std::optional<clock::time_point> nearest{};
+		for (auto const& [_, child] : children_) {
+			if (!child->deadline) continue;
+			if (!nearest || *child->deadline < *nearest)
+				nearest = child->deadline;
+		}
+		if (!nearest) return -1;
+
+		// round up, so that the loop does not spin just before the deadline
+		auto const left = std::chrono::ceil<std::chrono::milliseconds>(
+		    *nearest - now);
+		if (left.count() <= 0) return 0;
+		if (left.count() > INT_MAX) return INT_MAX;
+		return static_cast<int>(left.count());
+	}
+}  // namespace io::posix
+
+#else  // __linux__
+
+namespace io::posix {
+	// no epoll; io::run keeps a thread per pipe
+	reactor* reactor::instance() { return nullptr; }
+	bool reactor::watch(job&) { return false; }
+}  // namespace io::posix
+
+#endif  // __linux__
+
+namespace io::posix {
+	ssize_t write_to_child(int fd, char const* data, size_t size) noexcept {
+#ifdef F_SETNOSIGPIPE
+		::fcntl(fd, F_SETNOSIGPIPE, 1);
+		return ::write(fd, data, size);
+#else
+		sigset_t pipe_only{}, pending{}, previous{};
+		sigemptyset(&pipe_only);
+		sigaddset(&pipe_only, SIGPIPE);
+		// a SIGPIPE sent by someone else is left for the default action
+		sigpending(&pending);
+		auto const was_pending = sigismember(&pending, SIGPIPE) == 1;
+
+		::pthread_sigmask(SIG_BLOCK, &pipe_only, &previous);
+		auto const result = ::write(fd, data, size);
+		if (result < 0 && errno == EPIPE && !was_pending) {
+			// the signal raised by this write is taken off the thread,
+			// before it is unblocked
+			timespec const now{};
+			while (::sigtimedwait(&pipe_only, nullptr, &now) == -1 &&
+			       errno == EINTR) {
+			}
+			errno = EPIPE;
+		}
+		::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+		return result;
+#endif
+	}
+}  // namespace io::posix
@@ -0,0 +1,100 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <sys/types.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "io/bounded_stream.hh"
+
+namespace io::posix {
+	// One thread multiplexing, with epoll, the pipes of all the children
+	// started by io::run, where each of them used to get a thread per
+	// pipe. Exits are reported through pidfd, deadlines by killing the
+	// process group of the child.
+	class reactor {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		struct child_exit {
+			io::bounded_stream output{};
+			io::bounded_stream error{};
+			bool timed_out{false};
+		};
+
+		struct job {
+			pid_t pid{-1};
+			// parent's ends of the pipes; taken over by watch()
+			int input{-1};
+			int output{-1};
+			int error{-1};
+			std::string_view input_data{};
+			std::optional<clock::time_point> deadline{};
+			std::optional<io::spill_opts> spill{};
+			// called on the reactor thread, once the child exited and all
+			// its pipes got closed; the child is not reaped yet
+			std::move_only_function<void(child_exit&&)> on_exit{};
+		};
+
+		// nullptr, if the kernel lacks epoll or pidfd
+		static reactor* instance();
+
+		// false, if the child cannot be watched; the job is left untouched
+		// and the caller keeps the descriptors
+		bool watch(job& item);
+
+		~reactor();
+		reactor(reactor const&) = delete;
+		reactor& operator=(reactor const&) = delete;
+
+	private:
+		struct watched;
+		struct source {
+			enum kind { exit, input, output, error };
+			watched* owner{};
+			kind type{};
+			int fd{-1};
+		};
+
+		struct watched {
+			pid_t pid{-1};
+			std::array<source, 4> sources{};
+			std::string_view input_data{};
+			std::optional<clock::time_point> deadline{};
+			std::move_only_function<void(child_exit&&)> on_exit{};
+			child_exit result{};
+
+			bool done() const noexcept;
+		};
+
+		reactor(int epoll, int wakeup);
+
+		void loop(std::stop_token tok);
+		void on_event(source& src, std::uint32_t events);
+		void close_source(source& src);
+		int next_timeout(clock::time_point now);
+
+		int epoll_{-1};
+		int wakeup_{-1};
+		std::mutex m_{};
+		std::map<pid_t, std::unique_ptr<watched>> children_{};
+		std::jthread thread_{};
+	};
+
+	// write(), which fails with EPIPE, once the child closed its end of
+	// the pipe, instead of taking the runner down with SIGPIPE; SIGPIPE
+	// is neither ignored, nor blocked for good, as the children would
+	// inherit it
+	ssize_t write_to_child(int fd, char const* data, size_t size) noexcept;
+}  // namespace io::posix
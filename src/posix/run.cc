@@ -4,16 +4,40 @@
 #include "io/run.hh"
 #include <fcntl.h>
 #include <fmt/format.h>
+#include <signal.h>
 #include <spawn.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <termios.h>
 #include <unistd.h>
 #include <args/parser.hpp>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <filesystem>
+#include <future>
 #include <mutex>
+#include <set>
 #include <thread>
+#include <utility>
+#include <vector>
 #include "base/str.hh"
 #include "io/path_env.hh"
+#include "io/program_cache.hh"
+#include "posix/reactor.hh"
+#include "posix/spawn.hh"
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <climits>
+#include <map>
+#include <memory>
+#endif
 
 // define STDOUT_DUMP
 
@@ -48,27 +72,38 @@ namespace io {
 		                            std::string const& program) {
 			if (program.find('/') != std::string::npos) return program;
 
-			auto path_str = env(environment_variable);
-			auto dirs = split(bin.native(), path_str);
+			auto const path_str = env(environment_variable);
+			auto search_path = bin.native();
+			search_path.push_back(':');
+			search_path.append(path_str);
 
-			for (auto const& dir : dirs) {
-				auto path = std::filesystem::path{dir} / program;
-				if (executable(path)) {
-					return path;
-				}
-			}
+			return program_cache::instance().find(
+			    search_path, program, [&]() -> std::filesystem::path {
+				    auto dirs = split(bin.native(), path_str);
+
+				    for (auto const& dir : dirs) {
+					    auto path = std::filesystem::path{dir} / program;
+					    if (executable(path)) {
+						    return path;
+					    }
+				    }
 
-			return {};
+				    return {};
+			    });
 		}
 
 		struct pipe_type {
 			int read{-1};
 			int write{-1};
+			// parent's descriptor of the memfd, whose other descriptor,
+			// `write`, is given to the child
+			int spool{-1};
 			std::string debug;
 
 			~pipe_type() {
 				close_side(read);
 				close_side(write);
+				close_side(spool);
 			}
 
 			void close_read() { close_side(read); }
@@ -87,6 +122,76 @@ namespace io {
 				return true;
 			}
 
+			// No reader is needed, while the child runs, and the output
+			// is read back in one go, once it is gone. A memfd is not
+			// bounded by anything but the memory, so with a limit, the
+			// pipe is drained into a bounded_stream instead, which spills
+			// past the limit while the child still writes. Pipes are also
+			// used, where there is no memfd.
+			bool open_spool(std::optional<spill_opts> const& spill,
+			                std::string& debug) {
+#ifdef __linux__
+				if (!spill) {
+					auto const fd = ::memfd_create("json-runner", MFD_CLOEXEC);
+					if (fd != -1) {
+						spool = ::fcntl(fd, F_DUPFD_CLOEXEC, 3);
+						if (spool != -1) {
+							write = fd;
+							debug.append(fmt::format(
+							    "open_spool -> write:{} spool:{}\n", write,
+							    spool));
+							return true;
+						}
+						::close(fd);
+					}
+				}
+#endif
+				return open_pipe(debug);
+			}
+
+			int take_spool() noexcept { return std::exchange(spool, -1); }
+
+			// The child gets the slave side, the parent reads the master
+			// side like any other pipe; once the last slave descriptor is
+			// closed, the read ends with EIO. Without ONLCR the output
+			// keeps the line endings the child wrote.
+			bool open_pty(terminal const& size, std::string& debug) {
+				auto const master = ::posix_openpt(O_RDWR | O_NOCTTY);
+				char name[128];
+				if (master == -1 || ::grantpt(master) || ::unlockpt(master) ||
+				    ::ptsname_r(master, name, sizeof(name))) {
+					debug.append(fmt::format("open_pty: error {}\n", errno));
+					if (master != -1) ::close(master);
+					return open_pipe(debug);
+				}
+				::fcntl(master, F_SETFD, FD_CLOEXEC);
+
+				auto const slave = ::open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+				if (slave == -1) {
+					debug.append(fmt::format("open_pty: {}: error {}\n", name,
+					                         errno));
+					::close(master);
+					return open_pipe(debug);
+				}
+
+				termios attrs{};
+				if (!::tcgetattr(slave, &attrs)) {
+					attrs.c_oflag &= ~static_cast<tcflag_t>(ONLCR);
+					::tcsetattr(slave, TCSANOW, &attrs);
+				}
+				winsize window{};
+				window.ws_col = size.columns;
+				window.ws_row = size.rows;
+				::ioctl(master, TIOCSWINSZ, &window);
+
+				read = master;
+				write = slave;
+				debug.append(
+				    fmt::format("open_pty -> master:{} slave:{} {}x{}\n", read,
+				                write, size.columns, size.rows));
+				return true;
+			}
+
 			bool open_std(pipe direction) {
 				auto fd = direction == pipe::input    ? 0
 				          : direction == pipe::output ? 1
@@ -106,14 +211,31 @@ namespace io {
 
 			bool open(std::optional<std::string_view> const& input,
 			          pipe,
+			          std::optional<spill_opts> const&,
 			          std::string& debug) {
 				if (!input) return true;
 				debug.append("input: ");
 				return open_pipe(debug);
 			}
 
+			// the child reads the file itself, the runner never sees a
+			// byte of it
+			bool open_file(std::filesystem::path const& path,
+			               std::string& debug) {
+				read = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (read == -1) {
+					debug.append(fmt::format("input: {}: error {}\n",
+					                         path.native(), errno));
+					return false;
+				}
+				debug.append(fmt::format("input: {} -> fd:{}\n",
+				                         path.native(), read));
+				return true;
+			}
+
 			bool open(stream_decl const& decl,
 			          pipe direction,
+			          std::optional<spill_opts> const& spill,
 			          std::string& debug) {
 				switch (direction) {
 					case pipe::input:
@@ -134,8 +256,9 @@ namespace io {
 				if (decl == redir_to_error{}) debug.append(">&2: ");
 				if (decl == terminal{}) debug.append("pty: ");
 
-				if (decl == piped{}) return open_pipe(debug);
-				if (decl == terminal{}) return open_pipe(debug);
+				if (decl == piped{}) return open_spool(spill, debug);
+				if (decl == terminal{})
+					return open_pty(std::get<terminal>(decl), debug);
 				if (decl == devnull{}) return open_devnull(debug);
 
 				if (decl == redir_to_output{}) {
@@ -171,7 +294,9 @@ namespace io {
 					    while (size) {
 						    auto chunk = size;
 						    if (chunk > BUFSIZE) chunk = BUFSIZE;
-						    auto actual = ::write(fd, ptr, chunk);
+						    auto actual = posix::write_to_child(fd, ptr, chunk);
+						    if (actual < 0 && errno == EINTR) continue;
+						    // EPIPE: the child is done reading
 						    if (actual < 0) break;
 						    ptr += actual;
 						    size -= static_cast<size_t>(actual);
@@ -221,9 +346,9 @@ namespace io {
 			}
 #endif
 
-			std::thread async_read(std::string& dst, std::string_view name) {
+			std::thread async_read(bounded_stream& dst, std::string_view name) {
 				return std::thread(
-				    [name](pipe_type* self, std::string& bytes) {
+				    [name](pipe_type* self, bounded_stream& bytes) {
 					    char buffer[BUFSIZE];
 					    auto fd = self->read;
 
@@ -235,7 +360,7 @@ namespace io {
 						    self->debug.append(fmt::format("> {}:\n", name));
 						    self->debug.append(dump({buffer, buffer + actual}));
 #endif
-						    bytes.insert(bytes.end(), buffer, buffer + actual);
+						    bytes.append(buffer, static_cast<size_t>(actual));
 					    }
 				    },
 				    this, std::ref(dst));
@@ -254,13 +379,17 @@ namespace io {
 			pipe_type error{};
 
 			bool open(run_opts const& opts, std::string& debug) {
-#define OPEN(DIRECTION)                                            \
-	if (!DIRECTION.open(opts.DIRECTION, pipe::DIRECTION, debug)) { \
-		[[unlikely]];                                              \
-		return false;                                              \
+#define OPEN(DIRECTION)                                                       \
+	if (!DIRECTION.open(opts.DIRECTION, pipe::DIRECTION, opts.spill, debug)) { \
+		[[unlikely]];                                                         \
+		return false;                                                         \
 	}
 
-				OPEN(input);
+				if (opts.input_file) {
+					if (!input.open_file(*opts.input_file, debug)) return false;
+				} else {
+					OPEN(input);
+				}
 				OPEN(output);
 				OPEN(error);
 
@@ -278,11 +407,26 @@ namespace io {
 				return true;
 			}
 
-			std::string io(std::optional<std::string_view> const& input_data,
-			               capture& output_data) {
+			void close_child_ends() {
 				input.close_read();
 				output.close_write();
 				error.close_write();
+			}
+
+			std::array<int, 2> take_spools() noexcept {
+				return {output.take_spool(), error.take_spool()};
+			}
+
+			// after the reactor took over the parent's ends
+			void release_parent_ends() {
+				input.write = -1;
+				output.read = -1;
+				error.read = -1;
+			}
+
+			std::string io(std::optional<std::string_view> const& input_data,
+			               posix::reactor::child_exit& output_data) {
+				close_child_ends();
 
 				std::vector<std::thread> threads{};
 				threads.reserve((input.write > -1 && input_data ? 1u : 0u) +
@@ -314,11 +458,205 @@ namespace io {
 			}
 		};
 
+		std::atomic<posix::spawner>& spawner_choice() {
+#ifdef __linux__
+			static std::atomic<posix::spawner> choice{
+			    posix::spawner::clone_vfork};
+#else
+			static std::atomic<posix::spawner> choice{
+			    posix::spawner::posix_spawn};
+#endif
+			return choice;
+		}
+
+#ifdef __linux__
+		// Programs opened with O_PATH, once per path. The path is stat()-ed
+		// before each reuse, so a target replaced in the meantime (e.g. by
+		// the reinstall in --watch) is opened anew, instead of running the
+		// stale inode.
+		class exec_targets {
+		public:
+			struct target {
+				int fd{-1};
+				dev_t dev{};
+				ino_t ino{};
+				timespec changed{};
+
+				target() = default;
+				target(target const&) = delete;
+				target& operator=(target const&) = delete;
+				~target() {
+					if (fd != -1) ::close(fd);
+				}
+
+				bool same_as(struct stat const& st) const noexcept {
+					return dev == st.st_dev && ino == st.st_ino &&
+					       changed.tv_sec == st.st_ctim.tv_sec &&
+					       changed.tv_nsec == st.st_ctim.tv_nsec;
+				}
+			};
+
+			// nullptr, if the program cannot be opened; the child falls
+			// back to execve() with the path then
+			std::shared_ptr<target const> open(
+			    std::filesystem::path const& program) {
+				struct stat st {};
+				if (::stat(program.c_str(), &st)) return nullptr;
+
+				std::lock_guard lock{m_};
+				auto& slot = targets_[program.native()];
+				if (slot && slot->same_as(st)) return slot;
+				slot.reset();
+
+				auto next = std::make_shared<target>();
+				next->fd = ::open(program.c_str(), O_PATH | O_CLOEXEC);
+				// remember what was opened, not what was stat()-ed
+				if (next->fd == -1 || ::fstat(next->fd, &st)) return nullptr;
+				next->dev = st.st_dev;
+				next->ino = st.st_ino;
+				next->changed = st.st_ctim;
+				slot = std::move(next);
+				return slot;
+			}
+
+		private:
+			std::mutex m_{};
+			std::map<std::string, std::shared_ptr<target const>> targets_{};
+		};
+
+		struct clone_request {
+			char const* path{};
+			int exec_fd{-1};
+			char* const* argv{};
+			char* const* envp{};
+			char const* cwd{};
+			int input{-1};
+			int output{-1};
+			int error{-1};
+			unsigned fd_limit{};
+			bool own_group{true};
+			sigset_t mask{};
+			// errno of the failed call, written by the child
+			int failure{0};
+		};
+
+		[[noreturn]] void child_failed(clone_request& req) {
+			req.failure = errno ? errno : ECHILD;
+			::_exit(127);
+		}
+
+		void close_fds(unsigned first, unsigned last, unsigned limit) {
+			if (first > last) return;
+#ifdef SYS_close_range
+			if (!::syscall(SYS_close_range, first, last, 0)) return;
+#endif
+			// kernels older than 5.9
+			for (auto fd = first; fd <= last && fd < limit; ++fd)
+				::close(static_cast<int>(fd));
+		}
+
+		// Runs on the parent's memory, while the parent is suspended, so
+		// only async-signal-safe calls are allowed and nothing may be
+		// allocated.
+		int clone_child(void* arg) {
+			auto& req = *static_cast<clone_request*>(arg);
+
+			if (req.own_group) ::setpgid(0, 0);
+			if (req.cwd && ::chdir(req.cwd)) child_failed(req);
+
+			if (req.input != -1 && ::dup2(req.input, 0) == -1)
+				child_failed(req);
+			if (req.output != -1 && ::dup2(req.output, 1) == -1)
+				child_failed(req);
+			if (req.error != -1 && ::dup2(req.error, 2) == -1)
+				child_failed(req);
+
+			// the target is closed on exec, it only needs to live until
+			// then
+			if (req.exec_fd > 2) {
+				auto const fd = static_cast<unsigned>(req.exec_fd);
+				close_fds(3, fd - 1, req.fd_limit);
+				close_fds(fd + 1, UINT_MAX, req.fd_limit);
+			} else {
+				close_fds(3, UINT_MAX, req.fd_limit);
+			}
+
+			::sigprocmask(SIG_SETMASK, &req.mask, nullptr);
+#ifdef SYS_execveat
+			if (req.exec_fd != -1)
+				::syscall(SYS_execveat, req.exec_fd, "", req.argv, req.envp,
+				          AT_EMPTY_PATH);
+#endif
+			// no execveat, or a script, whose interpreter cannot reopen a
+			// descriptor closed on exec
+			::execve(req.path, req.argv, req.envp);
+			child_failed(req);
+		}
+
+		// false, if clone() itself failed and posix_spawn is worth a try;
+		// otherwise, `result` is the child, or -1, if it could not exec
+		bool clone_spawn(std::filesystem::path const& program_path,
+		                 char* const* argv,
+		                 char* const* envp,
+		                 std::filesystem::path const* cwd,
+		                 pipes_type const& pipes,
+		                 bool own_group,
+		                 pid_t& result) {
+			static exec_targets targets{};
+			static constexpr size_t STACK_SIZE = 64 * 1024;
+			static auto const fd_limit = [] {
+				auto const limit = ::sysconf(_SC_OPEN_MAX);
+				return limit < 0 || limit > INT_MAX
+				           ? 65536u
+				           : static_cast<unsigned>(limit);
+			}();
+
+			auto const target = targets.open(program_path);
+			clone_request req{
+			    .path = program_path.c_str(),
+			    .exec_fd = target ? target->fd : -1,
+			    .argv = argv,
+			    .envp = envp,
+			    .cwd = cwd ? cwd->c_str() : nullptr,
+			    .input = pipes.input.read,
+			    .output = pipes.output.write,
+			    .error = pipes.error.write,
+			    .fd_limit = fd_limit,
+			    .own_group = own_group,
+			};
+
+			std::unique_ptr<char[]> stack{new char[STACK_SIZE]};
+			sigset_t all{};
+			sigfillset(&all);
+			// no handler may run in the child, while it shares our memory
+			::pthread_sigmask(SIG_BLOCK, &all, &req.mask);
+			auto const child =
+			    ::clone(clone_child, stack.get() + STACK_SIZE,
+			            CLONE_VM | CLONE_VFORK | SIGCHLD, &req);
+			auto const clone_error = errno;
+			::pthread_sigmask(SIG_SETMASK, &req.mask, nullptr);
+
+			if (child == -1) {
+				errno = clone_error;
+				return false;
+			}
+
+			result = child;
+			if (req.failure) {
+				::waitpid(child, nullptr, 0);
+				errno = req.failure;
+				result = -1;
+			}
+			return true;
+		}
+#endif
+
 		pid_t spawn(std::filesystem::path const& program_path,
 		            args::arglist args,
-		            std::map<std::string, std::string> const* env_ptr,
+		            env_block const* env,
 		            std::filesystem::path const* cwd,
 		            pipes_type const& pipes,
+		            bool own_group,
 		            std::string& debug) {
 			std::vector<char*> argv;
 			argv.reserve(2 + args.size());  // arg0 and NULL
@@ -328,23 +666,18 @@ namespace io {
 				argv.push_back(const_cast<char*>(args[i].data()));
 			argv.push_back(nullptr);
 
-			std::vector<std::string> env_pairs{};
-			std::vector<char*> environment{};
-
-			if (env_ptr) {
-				env_pairs.reserve(env_ptr->size());
-				environment.reserve(env_ptr->size() + 1);
-
-				for (auto const& [key, value] : *env_ptr) {
-					env_pairs.push_back(fmt::format("{}={}", key, value));
-				}
-
-				for (auto& env_var : env_pairs) {
-					environment.push_back(env_var.data());
-				}
+			auto const envp = env ? env->envp() : environ;
 
-				environment.push_back(nullptr);
+#ifdef __linux__
+			if (posix::current_spawner() == posix::spawner::clone_vfork) {
+				pid_t child{-1};
+				if (clone_spawn(program_path, argv.data(), envp, cwd, pipes,
+				                own_group, child))
+					return child;
+				debug.append(fmt::format(
+				    "clone: error {}, falling back to posix_spawn\n", errno));
 			}
+#endif
 
 #if defined(STDOUT_DUMP)
 #define CHECK(X)                                         \
@@ -408,76 +741,416 @@ namespace io {
 			                })>
 			    attr_anchor{&attrs};
 
-			CHECK(posix_spawnattr_setpgroup(&attrs, 0));
+			if (own_group) {
+				CHECK(posix_spawnattr_setflags(&attrs, POSIX_SPAWN_SETPGROUP));
+				CHECK(posix_spawnattr_setpgroup(&attrs, 0));
+			}
 
-			pid_t result;
+			pid_t result{-1};
 			CHECK(posix_spawn(
 			    &result, program_path.c_str(), &actions, &attrs, argv.data(),
-			    environment.empty() ? environ : environment.data()));
+			    envp));
 			return result;
 		}
+
+		// Every child is spawned as a leader of its own process group; the
+		// list keeps those groups, so cancel_all() can reach grandchildren
+		// as well.
+		class children_list {
+		public:
+			// returns false, if cancel() was already called and the new
+			// child needs to be killed right away
+			bool add(pid_t pid) {
+				std::lock_guard lock{m_};
+				running_.insert(pid);
+				return !cancelled_;
+			}
+
+			void remove(pid_t pid) {
+				std::lock_guard lock{m_};
+				running_.erase(pid);
+			}
+
+			std::vector<pid_t> running() {
+				std::lock_guard lock{m_};
+				return {running_.begin(), running_.end()};
+			}
+
+			std::vector<pid_t> cancel() {
+				std::lock_guard lock{m_};
+				cancelled_ = true;
+				return {running_.begin(), running_.end()};
+			}
+
+			bool cancelled() const noexcept { return cancelled_; }
+			void resume() noexcept { cancelled_ = false; }
+
+		private:
+			std::mutex m_{};
+			std::set<pid_t> running_{};
+			std::atomic<bool> cancelled_{false};
+		};
+
+		children_list& children() {
+			static children_list list{};
+			return list;
+		}
+
+		// Kills the process group, unless stopped before the deadline.
+		class watchdog {
+		public:
+			watchdog(pid_t group,
+			         std::optional<std::chrono::milliseconds> timeout) {
+				if (!timeout) return;
+				auto const deadline =
+				    std::chrono::steady_clock::now() + *timeout;
+				thread_ = std::jthread{[this, group,
+				                        deadline](std::stop_token tok) {
+					std::mutex m{};
+					std::condition_variable_any cv{};
+					std::unique_lock lock{m};
+					if (cv.wait_until(lock, tok, deadline,
+					                  [&tok] { return tok.stop_requested(); }))
+						return;
+					fired_ = true;
+					::kill(-group, SIGKILL);
+				}};
+			}
+
+			// must be called before the child is reaped
+			bool stop() {
+				if (thread_.joinable()) {
+					thread_.request_stop();
+					thread_.join();
+				}
+				return fired_;
+			}
+
+		private:
+			std::atomic<bool> fired_{false};
+			std::jthread thread_{};
+		};
 	}  // namespace
 
-	capture run(run_opts const& options) {
-		capture result{};
+	namespace {
+		std::optional<capture> refused(run_opts const& options) {
+			if (children().cancelled())
+				return capture{.return_code = -ECANCELED, .cancelled = true};
+			if (options.timeout && options.timeout->count() <= 0)
+				return capture{.return_code = -ETIMEDOUT, .timed_out = true};
+			return std::nullopt;
+		}
 
-		auto const executable = where({}, "PATH", options.exec);
-		if (executable.empty()) {
-			result.return_code = -ENOENT;
-			return result;
+		pid_t start(run_opts const& options,
+		            pipes_type& pipes,
+		            std::string& debug,
+		            capture& result) {
+			auto const executable = where({}, "PATH", options.exec);
+			if (executable.empty()) {
+				result.return_code = -ENOENT;
+				return -1;
+			}
+
+			if (!pipes.open(options, debug)) {
+				// GCOV_EXCL_START[POSIX]
+				[[unlikely]];
+				debug.append("pipes did not open\n");
+				result.return_code = 128;
+				return -1;
+			}  // GCOV_EXCL_STOP
+
+			auto child = spawn(executable, options.args, options.env,
+			                   options.cwd, pipes, !options.foreground, debug);
+			if (child < 0) {
+				// GCOV_EXCL_START[POSIX]
+				[[unlikely]];
+				debug.append("process did not spawn\n");
+				result.return_code = 128;
+				return -1;
+			}  // GCOV_EXCL_STOP
+
+			// not a group leader, there is no group to signal
+			if (options.foreground) return child;
+			if (!children().add(child)) ::kill(-child, SIGKILL);
+			return child;
 		}
 
-		std::string debug;
-		pipes_type pipes{};
-		if (!pipes.open(options, debug)) {
-			// GCOV_EXCL_START[POSIX]
-			[[unlikely]];
-			debug.append("pipes did not open\n");
-			result.return_code = 128;
-			return result;
-		}  // GCOV_EXCL_STOP
+		posix::reactor::job job_for(pid_t child,
+		                            pipes_type& pipes,
+		                            run_opts const& options) {
+			pipes.close_child_ends();
+			return {
+			    .pid = child,
+			    .input = pipes.input.write,
+			    .output = pipes.output.read,
+			    .error = pipes.error.read,
+			    .input_data = options.input.value_or(std::string_view{}),
+			    .deadline = options.timeout && !options.foreground
+			                    ? std::optional{posix::reactor::clock::now() +
+			                                    *options.timeout}
+			                    : std::nullopt,
+			    .spill = options.spill,
+			};
+		}
 
-		auto child = spawn(executable, options.args, options.env, options.cwd,
-		                   pipes, debug);
+		// for systems, where the reactor is not available
+		posix::reactor::child_exit wait_threaded(pid_t child,
+		                                         pipes_type& pipes,
+		                                         run_opts const& options,
+		                                         std::string& debug) {
+			posix::reactor::child_exit streams{};
+			if (options.spill) {
+				streams.output = bounded_stream{*options.spill, "stdout"};
+				streams.error = bounded_stream{*options.spill, "stderr"};
+			}
+			watchdog timer{child, options.foreground ? std::nullopt
+			                                         : options.timeout};
+
+			debug.append(pipes.io(options.input, streams));
+
+			// leave the zombie in place until the group is off the list,
+			// so neither cancel_all() nor the watchdog signals a recycled
+			// process group
+			siginfo_t info{};
+			waitid(P_PID, static_cast<id_t>(child), &info,
+			       WEXITED | WNOWAIT);
+			streams.timed_out = timer.stop();
+			return streams;
+		}
 
-		debug.append(pipes.io(options.input, result));
+		// reads the whole memfd and closes it
+		void read_spool(int fd, std::string& dst) {
+			if (fd == -1) return;
+
+			struct stat st {};
+			if (!::fstat(fd, &st) && st.st_size > 0) {
+				dst.resize(static_cast<size_t>(st.st_size));
+				size_t offset{};
+				while (offset < dst.size()) {
+					auto const actual =
+					    ::pread(fd, dst.data() + offset, dst.size() - offset,
+					            static_cast<off_t>(offset));
+					if (actual < 0 && errno == EINTR) continue;
+					if (actual <= 0) break;
+					offset += static_cast<size_t>(actual);
+				}
+				dst.resize(offset);
+			}
+			::close(fd);
+		}
+
+		microseconds from_timeval(timeval const& tv) {
+			return std::chrono::seconds{tv.tv_sec} +
+			       microseconds{tv.tv_usec};
+		}
+
+		size_t from_counter(long value) {
+			return value < 0 ? 0u : static_cast<size_t>(value);
+		}
+
+		resource_usage usage_of(::rusage const& ru,
+		                        std::chrono::steady_clock::time_point started) {
+#ifdef __APPLE__
+			// bytes, not kilobytes
+			auto const max_rss_kb = from_counter(ru.ru_maxrss) / 1024;
+#else
+			auto const max_rss_kb = from_counter(ru.ru_maxrss);
+#endif
+			return {
+			    .wall = std::chrono::duration_cast<microseconds>(
+			        std::chrono::steady_clock::now() - started),
+			    .user = from_timeval(ru.ru_utime),
+			    .system = from_timeval(ru.ru_stime),
+			    .max_rss_kb = max_rss_kb,
+			    .minor_faults = from_counter(ru.ru_minflt),
+			    .major_faults = from_counter(ru.ru_majflt),
+			    .voluntary_switches = from_counter(ru.ru_nvcsw),
+			    .involuntary_switches = from_counter(ru.ru_nivcsw),
+			};
+		}
 
-		int status;
-		errno = 0;
-		auto const ret_pid = waitpid(child, &status, 0);
+		// the child has exited already, so wait4() will not block
+		capture finish(pid_t child,
+		               std::chrono::steady_clock::time_point started,
+		               posix::reactor::child_exit&& exited,
+		               std::array<int, 2> const& spools,
+		               [[maybe_unused]] std::string& debug,
+		               [[maybe_unused]] std::string* debug_out) {
+			capture result{.timed_out = exited.timed_out};
+			result.output = exited.output.take(result.output_spill);
+			result.error = exited.error.take(result.error_spill);
+			read_spool(spools[0], result.output);
+			read_spool(spools[1], result.error);
+			children().remove(child);
+
+			int status;
+			::rusage usage{};
+			errno = 0;
+			[[maybe_unused]] auto const ret_pid =
+			    ::wait4(child, &status, 0, &usage);
+			result.rusage = usage_of(usage, started);
 
 #if defined(STDOUT_DUMP)
-		auto const err = errno;
-
-		char str_error[1024];
-		str_error[sizeof(str_error) - 1] = 0;
-		auto str_error_msg = strerror_r(err, str_error, sizeof(str_error) - 1);
-
-		debug.append(fmt::format(
-		    "status[{}/{}, {}: {}]: {:x}; exit: {}, {}; term: {}, {} (core: "
-		    "{}); stop: {}, {}\n",
-		    child, ret_pid, err, str_error_msg, status,
-		    WIFEXITED(status) ? "yes"sv : "no"sv,
-		    WIFEXITED(status) ? fmt::to_string(static_cast<int>(
-		                            static_cast<char>(WEXITSTATUS(status))))
-		                      : "-"sv,
-		    WIFSIGNALED(status) ? "yes"sv : "no"sv,
-		    WIFSIGNALED(status) ? fmt::to_string(WTERMSIG(status)) : "-"sv,
-		    WIFSIGNALED(status) ? WCOREDUMP(status) ? "yes"sv : "no"sv : "-"sv,
-		    WIFSTOPPED(status) ? "yes"sv : "no"sv,
-		    WIFSTOPPED(status) ? fmt::to_string(WSTOPSIG(status)) : "-"sv));
-		if (options.debug) *options.debug = std::move(debug);
+			auto const err = errno;
+
+			char str_error[1024];
+			str_error[sizeof(str_error) - 1] = 0;
+			auto str_error_msg =
+			    strerror_r(err, str_error, sizeof(str_error) - 1);
+
+			debug.append(fmt::format(
+			    "status[{}/{}, {}: {}]: {:x}; exit: {}, {}; term: {}, {} "
+			    "(core: {}); stop: {}, {}\n",
+			    child, ret_pid, err, str_error_msg, status,
+			    WIFEXITED(status) ? "yes"sv : "no"sv,
+			    WIFEXITED(status)
+			        ? fmt::to_string(static_cast<int>(
+			              static_cast<char>(WEXITSTATUS(status))))
+			        : "-"sv,
+			    WIFSIGNALED(status) ? "yes"sv : "no"sv,
+			    WIFSIGNALED(status) ? fmt::to_string(WTERMSIG(status)) : "-"sv,
+			    WIFSIGNALED(status) ? WCOREDUMP(status) ? "yes"sv : "no"sv
+			                        : "-"sv,
+			    WIFSTOPPED(status) ? "yes"sv : "no"sv,
+			    WIFSTOPPED(status) ? fmt::to_string(WSTOPSIG(status)) : "-"sv));
+			if (debug_out) *debug_out = std::move(debug);
 #endif
 
 #define I_EXIT_STATUS(status) \
 	static_cast<int>(static_cast<char>(WEXITSTATUS(status)))
-		auto const code = WIFEXITED(status)     ? I_EXIT_STATUS(status)
-		                  : WIFSIGNALED(status) ? WTERMSIG(status)
-		                  : WIFSTOPPED(status)  ? WSTOPSIG(status)
-		                                        : 128;
+			auto const code = WIFEXITED(status)     ? I_EXIT_STATUS(status)
+			                  : WIFSIGNALED(status) ? WTERMSIG(status)
+			                  : WIFSTOPPED(status)  ? WSTOPSIG(status)
+			                                        : 128;
+
+			result.return_code = code;
+			result.cancelled = children().cancelled() && WIFSIGNALED(status);
+			return result;
+		}
+	}  // namespace
+
+	capture run(run_opts const& options) {
+		if (auto refusal = refused(options)) return std::move(*refusal);
+
+		auto const started = std::chrono::steady_clock::now();
+		capture result{};
+		std::string debug;
+		pipes_type pipes{};
+		auto const child = start(options, pipes, debug, result);
+		if (child < 0) return result;
+
+		if (auto loop = posix::reactor::instance()) {
+			std::promise<posix::reactor::child_exit> exited{};
+			auto job = job_for(child, pipes, options);
+			job.on_exit = [&exited](posix::reactor::child_exit&& status) {
+				exited.set_value(std::move(status));
+			};
+			if (loop->watch(job)) {
+				pipes.release_parent_ends();
+				return finish(child, started, exited.get_future().get(),
+				              pipes.take_spools(), debug, options.debug);
+			}
+		}
+
+		auto exited = wait_threaded(child, pipes, options, debug);
+		return finish(child, started, std::move(exited), pipes.take_spools(),
+		              debug, options.debug);
+	}
+
+	void run_async(run_opts const& options,
+	               std::move_only_function<void(capture&&)> on_done) {
+		if (auto refusal = refused(options))
+			return on_done(std::move(*refusal));
+
+		auto const started = std::chrono::steady_clock::now();
+		capture result{};
+		std::string debug;
+		pipes_type pipes{};
+		auto const child = start(options, pipes, debug, result);
+		if (child < 0) return on_done(std::move(result));
+
+		if (auto loop = posix::reactor::instance()) {
+			auto job = job_for(child, pipes, options);
+			job.on_exit = [child, started, spools = pipes.take_spools(),
+			               on_done = std::move(on_done)](
+			                  posix::reactor::child_exit&& status) mutable {
+				std::string ignore{};
+				on_done(finish(child, started, std::move(status), spools,
+				               ignore, nullptr));
+			};
+			if (loop->watch(job)) {
+				pipes.release_parent_ends();
+				return;
+			}
+			return job.on_exit(wait_threaded(child, pipes, options, debug));
+		}
+
+		auto exited = wait_threaded(child, pipes, options, debug);
+		on_done(finish(child, started, std::move(exited),
+		               pipes.take_spools(), debug, options.debug));
+	}
+
+	bool runs_async() noexcept {
+		return posix::reactor::instance() != nullptr;
+	}
+
+	void cancel_all(std::chrono::milliseconds grace) {
+		for (auto const group : children().cancel())
+			::kill(-group, SIGTERM);
+
+		auto const deadline = std::chrono::steady_clock::now() + grace;
+		while (std::chrono::steady_clock::now() < deadline) {
+			if (children().running().empty()) return;
+			std::this_thread::sleep_for(10ms);
+		}
+
+		for (auto const group : children().running())
+			::kill(-group, SIGKILL);
+	}
+
+	bool cancelled() noexcept { return children().cancelled(); }
+	void resume() noexcept { children().resume(); }
+
+	void cancel_on_signals(std::chrono::milliseconds grace) {
+		// the handler may only write(); the rest is done on a thread
+		static int wakeup[2]{-1, -1};
+		if (::pipe(wakeup)) return;
+		for (auto const fd : wakeup)
+			::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		std::thread{[grace] {
+			int sig{};
+			while (true) {
+				auto const actual = ::read(wakeup[0], &sig, sizeof(sig));
+				if (actual == sizeof(sig)) break;
+				if (actual < 0 && errno == EINTR) continue;
+				return;
+			}
+
+			cancel_all(grace);
+			// go down the way the signal would take us in the first place
+			::signal(sig, SIG_DFL);
+			::kill(::getpid(), sig);
+		}}.detach();
+
+		struct sigaction action {};
+		action.sa_handler = [](int sig) {
+			auto const saved = errno;
+			[[maybe_unused]] auto ignore =
+			    ::write(wakeup[1], &sig, sizeof(sig));
+			errno = saved;
+		};
+		sigemptyset(&action.sa_mask);
+		::sigaction(SIGINT, &action, nullptr);
+		::sigaction(SIGTERM, &action, nullptr);
+	}
+
+	void posix::use_spawner(spawner which) noexcept {
+		spawner_choice().store(which);
+	}
 
-		result.return_code = code;
-		return result;
+	posix::spawner posix::current_spawner() noexcept {
+		return spawner_choice().load();
 	}
 
 	std::optional<std::filesystem::path> find_program(
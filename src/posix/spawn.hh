@@ -0,0 +1,19 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+namespace io::posix {
+	// How io::run starts its children.
+	//
+	// `clone_vfork` is a Linux-only path: the child is created with
+	// clone(CLONE_VM | CLONE_VFORK), runs the target from a descriptor
+	// opened once per program and closes every descriptor past stderr
+	// with close_range(), so no child keeps a pipe of its sibling open.
+	// It is the default, where available; any other system, or a kernel
+	// refusing the clone, ends up with `posix_spawn`.
+	enum class spawner { posix_spawn, clone_vfork };
+
+	void use_spawner(spawner which) noexcept;
+	spawner current_spawner() noexcept;
+}  // namespace io::posix
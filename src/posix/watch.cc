@@ -0,0 +1,169 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "io/watch.hh"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+
+namespace io {
+	namespace {
+		constexpr std::uint32_t dir_events =
+		    IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE |
+		    IN_CREATE | IN_DELETE_SELF | IN_ONLYDIR;
+
+		bool readable(int fd, int timeout) {
+			pollfd item{.fd = fd, .events = POLLIN, .revents = 0};
+			while (true) {
+				auto const result = ::poll(&item, 1, timeout);
+				if (result < 0 && errno == EINTR) continue;
+				return result > 0;
+			}
+		}
+	}  // namespace
+
+	std::unique_ptr<watcher> watcher::create() {
+		auto const fd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+		if (fd == -1) return nullptr;
+		return std::unique_ptr<watcher>{new watcher{fd}};
+	}
+
+	watcher::~watcher() { ::close(fd_); }
+
+	bool watcher::add_tree(fs::path const& dir) {
+		if (!add_dir(dir, true)) return false;
+
+		std::error_code ec{};
+		for (auto const& entry : fs::recursive_directory_iterator{dir, ec}) {
+			if (entry.is_directory(ec)) add_dir(entry.path(), true);
+		}
+		return true;
+	}
+
+	bool watcher::add_file(fs::path const& filename) {
+		auto const dir = filename.parent_path();
+		if (!add_dir(dir, false)) return false;
+		for (auto& [_, watched] : dirs_) {
+			if (watched.path == dir) watched.names.insert(filename.filename());
+		}
+		return true;
+	}
+
+	bool watcher::add_dir(fs::path const& dir, bool recursive) {
+		auto const wd = ::inotify_add_watch(fd_, dir.c_str(), dir_events);
+		if (wd == -1) return false;
+		auto& watched = dirs_[wd];
+		watched.path = dir;
+		watched.recursive = watched.recursive || recursive;
+		// a tree watched as a whole is not narrowed to single files
+		if (watched.recursive) watched.names.clear();
+		return true;
+	}
+
+	std::vector<fs::path> watcher::wait(std::chrono::milliseconds settle) {
+		std::set<fs::path> changes{};
+		while (changes.empty()) {
+			if (!readable(fd_, -1)) return {};
+			read_events(changes);
+		}
+
+		auto const quiet = settle.count() > INT_MAX
+		                       ? INT_MAX
+		                       : static_cast<int>(settle.count());
+		while (readable(fd_, quiet))
+			read_events(changes);
+
+		return {changes.begin(), changes.end()};
+	}
+
+	void watcher::report_all(watched_dir const& watched,
+	                         std::set<fs::path>& changes) {
+		if (watched.names.empty()) {
+			changes.insert(watched.path);
+			return;
+		}
+		for (auto const& name : watched.names)
+			changes.insert(watched.path / name);
+	}
+
+	void watcher::read_events(std::set<fs::path>& changes) {
+		alignas(inotify_event) char buffer[4096];
+		while (true) {
+			auto const length = ::read(fd_, buffer, sizeof(buffer));
+			if (length <= 0) return;
+
+			for (auto ptr = buffer; ptr < buffer + length;) {
+				auto const& event = *reinterpret_cast<inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event.len;
+
+				// the kernel dropped some events; any file might have
+				// changed
+				if (event.mask & IN_Q_OVERFLOW) {
+					for (auto const& [_, watched] : dirs_)
+						report_all(watched, changes);
+					continue;
+				}
+
+				auto it = dirs_.find(event.wd);
+				if (it == dirs_.end()) continue;
+				if (event.mask & IN_DELETE_SELF) {
+					report_all(it->second, changes);
+					continue;
+				}
+				// the watch is gone, e.g. after IN_DELETE_SELF; its number
+				// may be given to another directory
+				if (event.mask & IN_IGNORED) {
+					dirs_.erase(it);
+					continue;
+				}
+				if (!event.len) continue;
+				auto const& watched = it->second;
+				auto const name = fs::path{event.name};
+				auto const path = watched.path / name;
+
+				if (event.mask & IN_ISDIR) {
+					if (!(event.mask & (IN_CREATE | IN_MOVED_TO)) ||
+					    !watched.recursive)
+						continue;
+					// the files may have been written, before the new
+					// directory got its watch
+					add_tree(path);
+					std::error_code ec{};
+					for (auto const& entry :
+					     fs::recursive_directory_iterator{path, ec}) {
+						if (entry.is_regular_file(ec))
+							changes.insert(entry.path());
+					}
+					continue;
+				}
+				// files are reported once they are closed
+				if (event.mask & IN_CREATE) continue;
+				if (!watched.names.empty() && !watched.names.contains(name))
+					continue;
+				changes.insert(path);
+			}
+		}
+	}
+}  // namespace io
+
+#else  // __linux__
+
+namespace io {
+	// no inotify; --watch is not available
+	std::unique_ptr<watcher> watcher::create() { return nullptr; }
+	watcher::~watcher() = default;
+	bool watcher::add_tree(fs::path const&) { return false; }
+	bool watcher::add_file(fs::path const&) { return false; }
+	std::vector<fs::path> watcher::wait(std::chrono::milliseconds) {
+		return {};
+	}
+	bool watcher::add_dir(fs::path const&, bool) { return false; }
+	void watcher::report_all(watched_dir const&, std::set<fs::path>&) {}
+	void watcher::read_events(std::set<fs::path>&) {}
+}  // namespace io
+
+#endif  // __linux__
@@ -0,0 +1,206 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/bench.hh"
+#include <json/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "base/shell.hh"
+#include "base/str.hh"
+#include "io/file.hh"
+
+using namespace std::literals;
+
+namespace testbed {
+	namespace {
+		double as_ms(io::microseconds time) {
+			return std::chrono::duration<double, std::milli>(time).count();
+		}
+
+		// one-sided, 95%; for df over 30, the value of the nearest lower
+		// row of the usual tables
+		double t_critical(double df) {
+			static constexpr double table[] = {
+			    6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860,
+			    1.833, 1.812, 1.796, 1.782, 1.771, 1.761, 1.753, 1.746,
+			    1.740, 1.734, 1.729, 1.725, 1.721, 1.717, 1.714, 1.711,
+			    1.708, 1.706, 1.703, 1.701, 1.699, 1.697,
+			};
+			if (df < 1) return table[0];
+			if (df < 31) return table[static_cast<size_t>(df) - 1];
+			if (df < 40) return table[29];
+			if (df < 60) return 1.684;
+			if (df < 120) return 1.671;
+			return 1.658;
+		}
+
+		struct stats_field {
+			json::string_view name;
+			double bench_stats::*field;
+		};
+
+		constexpr stats_field stats_fields[] = {
+		    {u8"min_us"sv, &bench_stats::min},
+		    {u8"median_us"sv, &bench_stats::median},
+		    {u8"p95_us"sv, &bench_stats::p95},
+		    {u8"mean_us"sv, &bench_stats::mean},
+		    {u8"stddev_us"sv, &bench_stats::stddev},
+		};
+
+		// in whole microseconds, like the rusage in the history
+		bench_stats stats_from_json(json::map const* node) {
+			bench_stats result{};
+			if (!node) return result;
+			if (auto count = cast<long long>(node, u8"count");
+			    count && *count > 0)
+				result.count = static_cast<size_t>(*count);
+			for (auto const& [name, field] : stats_fields) {
+				if (auto value = cast<long long>(node, name); value)
+					result.*field = static_cast<double>(*value) / 1000.0;
+			}
+			return result;
+		}
+
+		json::map stats_to_json(bench_stats const& stats) {
+			json::map result{};
+			result.set(u8"count", static_cast<long long>(stats.count));
+			for (auto const& [name, field] : stats_fields) {
+				result.set(json::string{name},
+				           std::llround(stats.*field * 1000.0));
+			}
+			return result;
+		}
+	}  // namespace
+
+	bench_stats bench_stats::of(std::span<double const> samples) {
+		bench_stats result{.count = samples.size()};
+		if (samples.empty()) return result;
+
+		std::vector<double> sorted{samples.begin(), samples.end()};
+		std::sort(sorted.begin(), sorted.end());
+		auto const count = sorted.size();
+
+		result.min = sorted.front();
+		auto const middle = count / 2;
+		result.median = count % 2 ? sorted[middle]
+		                          : (sorted[middle - 1] + sorted[middle]) / 2;
+		// nearest rank
+		auto const rank = static_cast<size_t>(
+		    std::ceil(0.95 * static_cast<double>(count)));
+		result.p95 = sorted[std::max(rank, size_t{1}) - 1];
+
+		double sum{};
+		for (auto const sample : sorted)
+			sum += sample;
+		result.mean = sum / static_cast<double>(count);
+
+		if (count > 1) {
+			double squares{};
+			for (auto const sample : sorted)
+				squares += (sample - result.mean) * (sample - result.mean);
+			result.stddev =
+			    std::sqrt(squares / static_cast<double>(count - 1));
+		}
+		return result;
+	}
+
+	bench_entry bench_entry::of(std::span<io::resource_usage const> samples) {
+		std::vector<double> wall{}, cpu{};
+		wall.reserve(samples.size());
+		cpu.reserve(samples.size());
+		for (auto const& usage : samples) {
+			wall.push_back(as_ms(usage.wall));
+			cpu.push_back(as_ms(usage.user + usage.system));
+		}
+		return {.wall = bench_stats::of(wall), .cpu = bench_stats::of(cpu)};
+	}
+
+	std::optional<slowdown> slower(bench_stats const& baseline,
+	                               bench_stats const& current,
+	                               double min_ratio) {
+		if (baseline.count < 2 || current.count < 2 || baseline.mean <= 0)
+			return std::nullopt;
+
+		auto const ratio = current.mean / baseline.mean - 1;
+		if (ratio < min_ratio) return std::nullopt;
+
+		auto const base_var = baseline.stddev * baseline.stddev /
+		                      static_cast<double>(baseline.count);
+		auto const curr_var = current.stddev * current.stddev /
+		                      static_cast<double>(current.count);
+		auto const error = std::sqrt(base_var + curr_var);
+		// no noise at all on either side; the difference is all there is
+		if (error == 0) {
+			return slowdown{.ratio = ratio,
+			                .t = std::numeric_limits<double>::infinity()};
+		}
+
+		auto const t = (current.mean - baseline.mean) / error;
+		// Welch-Satterthwaite
+		auto const df =
+		    (base_var + curr_var) * (base_var + curr_var) /
+		    (base_var * base_var / static_cast<double>(baseline.count - 1) +
+		     curr_var * curr_var / static_cast<double>(current.count - 1));
+		if (t < t_critical(df)) return std::nullopt;
+		return slowdown{.ratio = ratio, .t = t};
+	}
+
+	void bench_baseline::load() {
+		entries_.clear();
+
+		auto file = io::fopen(filename_);
+		if (!file) return;
+		auto data = file.read();
+		auto root = json::read_json(
+		    {reinterpret_cast<char8_t const*>(data.data()), data.size()});
+
+		auto tests = cast<json::map>(root, u8"tests");
+		if (!tests) return;
+
+		for (auto const& [key, node] : tests->items()) {
+			entries_[from_u8s(key)] = {
+			    .wall = stats_from_json(cast<json::map>(node, u8"wall")),
+			    .cpu = stats_from_json(cast<json::map>(node, u8"cpu")),
+			};
+		}
+	}
+
+	void bench_baseline::store() const {
+		json::map tests{};
+		for (auto const& [key, entry] : entries_) {
+			json::map item{};
+			item.set(u8"wall", stats_to_json(entry.wall));
+			item.set(u8"cpu", stats_to_json(entry.cpu));
+			tests.set(to_u8s(key), std::move(item));
+		}
+
+		json::map root{};
+		root.set(u8"tests", std::move(tests));
+
+		json::string text;
+		json::write_json(text, root, json::four_spaces);
+		if (text.empty() || text.back() != u8'\n') text.push_back(u8'\n');
+		auto file = io::fopen(filename_, "wb");
+		if (!file) return;
+		file.store(text.data(), text.size());
+	}
+
+	bench_entry const* bench_baseline::find(
+	    fs::path const& test_filename) const {
+		auto it = entries_.find(key_for(test_filename));
+		if (it == entries_.end()) return nullptr;
+		return &it->second;
+	}
+
+	void bench_baseline::set(fs::path const& test_filename,
+	                         bench_entry const& entry) {
+		entries_[key_for(test_filename)] = entry;
+	}
+
+	std::string bench_baseline::key_for(fs::path const& test_filename) const {
+		return shell::get_generic_path(
+		    test_filename.lexically_relative(root_));
+	}
+}  // namespace testbed
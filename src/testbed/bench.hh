@@ -0,0 +1,75 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include "io/resource_usage.hh"
+
+namespace fs = std::filesystem;
+
+namespace testbed {
+	// Summary of the samples of one measure, in milliseconds.
+	struct bench_stats {
+		size_t count{};
+		double min{};
+		double median{};
+		double p95{};
+		double mean{};
+		double stddev{};
+
+		static bench_stats of(std::span<double const> samples);
+	};
+
+	// wall time and CPU time (user and system) of the repeated runs of
+	// a test
+	struct bench_entry {
+		bench_stats wall{};
+		bench_stats cpu{};
+
+		static bench_entry of(std::span<io::resource_usage const> samples);
+	};
+
+	struct slowdown {
+		// current mean over the baseline mean, minus one
+		double ratio{};
+		double t{};
+	};
+
+	// Welch's t-test, one-sided at 95%: set, when the `current` mean is
+	// significantly higher than the `baseline` one and at least
+	// `min_ratio` higher. Both need two samples or more.
+	std::optional<slowdown> slower(bench_stats const& baseline,
+	                               bench_stats const& current,
+	                               double min_ratio = 0.05);
+
+	// Timings of a dataset, kept inside of it, keyed by the path of the
+	// test file relative to the dataset. Entries are only added, so
+	// later runs compare to the first one; remove the file to start
+	// over.
+	class bench_baseline {
+	public:
+		// skipped by discover()
+		static constexpr auto filename = ".bench.json";
+
+		explicit bench_baseline(fs::path const& test_set_dir)
+		    : filename_{test_set_dir / filename}, root_{test_set_dir} {}
+
+		void load();
+		void store() const;
+
+		bench_entry const* find(fs::path const& test_filename) const;
+		void set(fs::path const& test_filename, bench_entry const& entry);
+
+	private:
+		std::string key_for(fs::path const& test_filename) const;
+
+		fs::path filename_{};
+		fs::path root_{};
+		std::map<std::string, bench_entry> entries_{};
+	};
+}  // namespace testbed
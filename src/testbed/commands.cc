@@ -5,6 +5,7 @@
 #include <fmt/format.h>
 #include <arch/io/file.hh>
 #include <arch/unpacker.hh>
+#include <algorithm>
 #include "base/shell.hh"
 #include "base/str.hh"
 #include "io/file.hh"
@@ -51,6 +52,19 @@ namespace testbed {
 		return !ec;
 	}
 
+	void commands::start_phase(
+	    std::optional<std::chrono::milliseconds> budget) {
+		deadline_.reset();
+		if (budget) deadline_ = std::chrono::steady_clock::now() + *budget;
+	}
+
+	std::optional<std::chrono::milliseconds> commands::time_left() const {
+		if (!deadline_) return std::nullopt;
+		auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+		    *deadline_ - std::chrono::steady_clock::now());
+		return std::max(left, std::chrono::milliseconds::zero());
+	}
+
 	bool commands::cd(fs::path const& dir) {
 		cwd_ /= dir;
 		return true;  // fs::is_directory(cwd_);
@@ -177,7 +191,9 @@ namespace testbed {
 		           "> starting shell: \033[1;" COLOR "m{}\033[m\n\n",
 		           name);
 
-		io::run({.exec = *shell_name, .cwd = &cwd()});
+		// in the foreground, or the shell stops on its first read from
+		// the terminal
+		io::run({.exec = *shell_name, .cwd = &cwd(), .foreground = true});
 		return true;
 	}
 
@@ -222,16 +238,6 @@ namespace testbed {
 		};
 	}
 
-	bool test::cd(fs::path const& dir) {
-		if (!commands::cd(dir)) return false;
-		if (linear) {
-			std::error_code ec{};
-			fs::current_path(cwd(), ec);
-			if (ec) return false;
-		}
-		return true;
-	}
-
 	bool test::store_variable(std::string const& var,
 	                          std::span<std::string const> call,
 	                          std::string& debug) {
@@ -245,7 +251,9 @@ namespace testbed {
 		                     .args = copy.args(),
 		                     .cwd = &cwd(),
 		                     .output = io::piped{},
-		                     .debug = &debug});
+		                     .debug = &debug,
+		                     .timeout = time_left()});
+		timed_out(proc);
 		if (proc.return_code != 0) return false;
 		auto output = trim(proc.output);
 		stored_env[var] = {output.data(), output.size()};
@@ -5,15 +5,18 @@
 
 #include <args/parser.hpp>
 #include <array>
+#include <chrono>
 #include <filesystem>
 #include <functional>
 #include <json/json.hpp>
 #include <map>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 #include "io/run.hh"
+#include "mt/coro.hh"
 
 namespace fs = std::filesystem;
 
@@ -25,6 +28,12 @@ namespace testbed {
 		std::function<
 		    bool(struct commands&, std::span<std::string const>, std::string&)>
 		    handler;
+		// used instead of the handler, if set; for commands, which wait
+		// for other processes and should not block a thread doing so
+		std::function<mt::co_task<bool>(struct commands&,
+		                                std::span<std::string const>,
+		                                std::string&)>
+		    async_handler{};
 	};
 
 	struct commands {
@@ -51,9 +60,27 @@ namespace testbed {
 		                      std::string& listing) = 0;
 		bool shell() const;
 
+		// Every process started by a command gets what is left of the
+		// current phase's budget; once one of them is killed over it, the
+		// test stays timed out.
+		void start_phase(std::optional<std::chrono::milliseconds> budget);
+		std::optional<std::chrono::milliseconds> time_left() const;
+		bool timed_out() const noexcept { return timed_out_; }
+		void timed_out(io::capture const& proc) noexcept {
+			if (proc.timed_out) timed_out_ = true;
+		}
+
 		static std::map<std::string, handler_info> handlers();
 
+	protected:
+		void reset_timeout() noexcept {
+			deadline_.reset();
+			timed_out_ = false;
+		}
+
 	private:
 		fs::path cwd_{fs::current_path()};
+		std::optional<std::chrono::steady_clock::time_point> deadline_{};
+		bool timed_out_{false};
 	};
 }  // namespace testbed
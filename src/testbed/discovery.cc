@@ -0,0 +1,148 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/discovery.hh"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <latch>
+#include <mutex>
+#include "testbed/bench.hh"
+
+using namespace std::literals;
+
+namespace testbed {
+	namespace {
+		class walker {
+		public:
+			explicit walker(mt::stealing_pool& pool) : pool_{pool} {}
+
+			void spawn(fs::path dir) {
+				{
+					std::lock_guard lock{m_};
+					++pending_;
+				}
+				pool_.push([this, dir = std::move(dir)] { visit(dir); });
+			}
+
+			// rethrows the first error of the visits, once all are done
+			std::vector<fs::path> wait() {
+				std::unique_lock lock{m_};
+				cv_.wait(lock, [this] { return pending_ == 0; });
+				if (error_) std::rethrow_exception(error_);
+				return std::move(found_);
+			}
+
+		private:
+			void visit(fs::path const& dir) {
+				// the wait must end, however the visit does
+				struct done {
+					walker& self;
+					~done() {
+						std::lock_guard lock{self.m_};
+						if (--self.pending_ == 0) self.cv_.notify_all();
+					}
+				} guard{*this};
+
+				try {
+					auto local = list(dir);
+					std::lock_guard lock{m_};
+					found_.insert(found_.end(),
+					              std::make_move_iterator(local.begin()),
+					              std::make_move_iterator(local.end()));
+				} catch (...) {
+					std::lock_guard lock{m_};
+					if (!error_) error_ = std::current_exception();
+				}
+			}
+
+			std::vector<fs::path> list(fs::path const& dir) {
+				std::vector<fs::path> local{};
+				std::error_code ec{};
+				auto it = fs::directory_iterator{dir, ec};
+				for (; !ec && it != fs::directory_iterator{};
+				     it.increment(ec)) {
+					auto const& entry = *it;
+					std::error_code ignore{};
+					if (entry.is_directory(ignore) &&
+					    !entry.is_symlink(ignore)) {
+						spawn(entry.path());
+						continue;
+					}
+					if (entry.path().extension() == ".json"sv &&
+					    entry.path().filename() != bench_baseline::filename)
+						local.push_back(entry.path());
+				}
+				if (ec) throw fs::filesystem_error{"cannot list", dir, ec};
+				return local;
+			}
+
+			mt::stealing_pool& pool_;
+			std::mutex m_{};
+			std::condition_variable cv_{};
+			size_t pending_{};
+			std::vector<fs::path> found_{};
+			std::exception_ptr error_{};
+		};
+	}  // namespace
+
+	std::vector<fs::path> discover(mt::stealing_pool& pool,
+	                               fs::path const& test_set_dir) {
+		walker walk{pool};
+		walk.spawn(test_set_dir);
+		auto result = walk.wait();
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	std::vector<test> load(mt::stealing_pool& pool,
+	                       std::span<fs::path const> filenames,
+	                       load_opts const& opts) {
+		std::vector<size_t> selected{};
+		selected.reserve(opts.run.empty() ? filenames.size()
+		                                  : opts.run.size());
+		for (size_t index = 1; index <= filenames.size(); ++index) {
+			if (!opts.run.empty() &&
+			    std::find(opts.run.begin(), opts.run.end(), index) ==
+			        opts.run.end())
+				continue;
+			selected.push_back(index);
+		}
+
+		std::vector<std::optional<test>> slots(selected.size());
+		std::vector<std::exception_ptr> errors(selected.size());
+		std::latch done{static_cast<std::ptrdiff_t>(selected.size())};
+
+		for (size_t slot = 0; slot < selected.size(); ++slot) {
+			pool.push([&, slot] {
+				// the wait below must end, however the task does
+				struct count_down {
+					std::latch& done;
+					~count_down() { done.count_down(); }
+				} guard{done};
+
+				try {
+					auto const index = selected[slot];
+					auto& loaded = slots[slot].emplace(
+					    test::load(filenames[index - 1], index, opts.schema));
+					if (loaded.ok && opts.nullify) loaded.nullify(opts.lang);
+				} catch (...) {
+					errors[slot] = std::current_exception();
+				}
+			});
+		}
+		done.wait();
+
+		for (auto const& error : errors) {
+			if (error) std::rethrow_exception(error);
+		}
+
+		std::vector<test> result{};
+		result.reserve(slots.size());
+		for (auto& loaded : slots) {
+			if (!loaded->ok || opts.nullify) continue;
+			result.push_back(std::move(*loaded));
+		}
+		return result;
+	}
+}  // namespace testbed
@@ -0,0 +1,36 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "mt/stealing_pool.hh"
+#include "testbed/test.hh"
+
+namespace fs = std::filesystem;
+
+namespace testbed {
+	// Walks the directory tree with one pool task per directory and
+	// returns sorted paths of all the JSON files found, so the numbering
+	// of the tests does not depend on the order of the directory entries.
+	std::vector<fs::path> discover(mt::stealing_pool& pool,
+	                               fs::path const& test_set_dir);
+
+	struct load_opts {
+		std::span<size_t const> run{};
+		std::optional<std::string> const& schema;
+		bool nullify{false};
+		std::optional<std::string> const& lang;
+	};
+
+	// Loads the test files in parallel; each test gets the index of its
+	// filename plus one, the list of indices in `run` (if not empty) picks
+	// the tests to be loaded.
+	std::vector<test> load(mt::stealing_pool& pool,
+	                       std::span<fs::path const> filenames,
+	                       load_opts const& opts);
+}  // namespace testbed
@@ -0,0 +1,76 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/dispatcher.hh"
+#include <algorithm>
+
+namespace testbed {
+	dispatcher::dispatcher(std::span<planned_test const> order,
+	                       size_t jobs,
+	                       resource_map const& capacities,
+	                       bool all_linear)
+	    : queue_{order.begin(), order.end()}
+	    , jobs_{jobs ? jobs : 1}
+	    , capacities_{capacities}
+	    , all_linear_{all_linear} {}
+
+	std::vector<planned_test> dispatcher::start_next() {
+		std::vector<planned_test> result{};
+		auto it = queue_.begin();
+		while (it != queue_.end() && held_.size() < jobs_) {
+			auto tokens = tokens_for(*it->item);
+			if (!try_acquire(tokens)) {
+				++it;
+				continue;
+			}
+			held_[it->item->index] = std::move(tokens);
+			result.push_back(*it);
+			it = queue_.erase(it);
+		}
+		return result;
+	}
+
+	void dispatcher::finished(size_t test_index) {
+		auto it = held_.find(test_index);
+		if (it == held_.end()) return;
+		release(it->second);
+		held_.erase(it);
+	}
+
+	std::vector<planned_test> dispatcher::cancel() {
+		std::vector<planned_test> result{queue_.begin(), queue_.end()};
+		queue_.clear();
+		return result;
+	}
+
+	resource_map dispatcher::tokens_for(test const& item) const {
+		auto result = item.resources;
+		if (item.linear || all_linear_) result[linear_token] = 1;
+
+		for (auto& [name, count] : result) {
+			auto it = capacities_.find(name);
+			auto const capacity = it == capacities_.end() ? 1u : it->second;
+			count = std::min(count, std::max(capacity, 1u));
+		}
+		return result;
+	}
+
+	bool dispatcher::try_acquire(resource_map const& tokens) {
+		for (auto const& [name, count] : tokens) {
+			auto it = capacities_.find(name);
+			auto const capacity = it == capacities_.end() ? 1u : it->second;
+			auto used = used_.find(name);
+			auto const taken = used == used_.end() ? 0u : used->second;
+			if (taken + count > std::max(capacity, 1u)) return false;
+		}
+
+		for (auto const& [name, count] : tokens)
+			used_[name] += count;
+		return true;
+	}
+
+	void dispatcher::release(resource_map const& tokens) {
+		for (auto const& [name, count] : tokens)
+			used_[name] -= count;
+	}
+}  // namespace testbed
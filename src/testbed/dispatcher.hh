@@ -0,0 +1,55 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+#include "testbed/schedule.hh"
+#include "testbed/test.hh"
+
+namespace testbed {
+	// Decides, which of the scheduled tests can be started. A test is
+	// started only if there is a free job and all its resource tokens can be
+	// taken; linear tests additionally take the single "linear" token.
+	// Resources not declared in `runner.chai` have the capacity of one and
+	// asking for more tokens than declared takes all of them.
+	class dispatcher {
+	public:
+		static constexpr auto linear_token = "linear";
+
+		dispatcher(std::span<planned_test const> order,
+		           size_t jobs,
+		           resource_map const& capacities,
+		           bool all_linear = false);
+
+		// Removes from the queue, and returns in the order of the schedule,
+		// all the tests, which can be started right now.
+		std::vector<planned_test> start_next();
+		void finished(size_t test_index);
+		// Empties the queue, returning the tests, which will never start.
+		std::vector<planned_test> cancel();
+
+		bool empty() const noexcept { return queue_.empty(); }
+		size_t running() const noexcept { return held_.size(); }
+		size_t jobs() const noexcept { return jobs_; }
+		// Lowering the limit does not stop any running test, it only
+		// holds the next ones back.
+		void jobs(size_t count) noexcept { jobs_ = count ? count : 1; }
+
+	private:
+		resource_map tokens_for(test const& item) const;
+		bool try_acquire(resource_map const& tokens);
+		void release(resource_map const& tokens);
+
+		std::list<planned_test> queue_{};
+		size_t jobs_{};
+		resource_map capacities_{};
+		resource_map used_{};
+		bool all_linear_{false};
+		std::map<size_t, resource_map> held_{};
+	};
+}  // namespace testbed
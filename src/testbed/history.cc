@@ -0,0 +1,154 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/history.hh"
+#include <json/json.hpp>
+#include "base/shell.hh"
+#include "base/str.hh"
+#include "io/file.hh"
+
+using namespace std::literals;
+
+namespace testbed {
+	namespace {
+		template <typename Counter>
+		struct usage_field {
+			json::string_view name;
+			Counter io::resource_usage::*field;
+		};
+
+		constexpr usage_field<io::microseconds> usage_times[] = {
+		    {u8"wall_us"sv, &io::resource_usage::wall},
+		    {u8"user_us"sv, &io::resource_usage::user},
+		    {u8"system_us"sv, &io::resource_usage::system},
+		};
+
+		constexpr usage_field<size_t> usage_counters[] = {
+		    {u8"max_rss_kb"sv, &io::resource_usage::max_rss_kb},
+		    {u8"minor_faults"sv, &io::resource_usage::minor_faults},
+		    {u8"major_faults"sv, &io::resource_usage::major_faults},
+		    {u8"voluntary_switches"sv,
+		     &io::resource_usage::voluntary_switches},
+		    {u8"involuntary_switches"sv,
+		     &io::resource_usage::involuntary_switches},
+		};
+
+		std::optional<io::resource_usage> rusage_from_json(
+		    json::map const* node) {
+			if (!node) return std::nullopt;
+			io::resource_usage result{};
+			for (auto const& [name, field] : usage_times) {
+				if (auto value = cast<long long>(node, name); value)
+					result.*field = io::microseconds{*value};
+			}
+			for (auto const& [name, field] : usage_counters) {
+				if (auto value = cast<long long>(node, name);
+				    value && *value > 0)
+					result.*field = static_cast<size_t>(*value);
+			}
+			return result;
+		}
+
+		json::map rusage_to_json(io::resource_usage const& usage) {
+			json::map result{};
+			for (auto const& [name, field] : usage_times) {
+				result.set(json::string{name},
+				           static_cast<long long>((usage.*field).count()));
+			}
+			for (auto const& [name, field] : usage_counters) {
+				result.set(json::string{name},
+				           static_cast<long long>(usage.*field));
+			}
+			return result;
+		}
+	}  // namespace
+
+	void history::load() {
+		records_.clear();
+
+		auto file = io::fopen(filename_);
+		if (!file) return;
+		auto data = file.read();
+		auto root = json::read_json(
+		    {reinterpret_cast<char8_t const*>(data.data()), data.size()});
+
+		auto tests = cast<json::map>(root, u8"tests");
+		if (!tests) return;
+
+		for (auto const& [key, node] : tests->items()) {
+			record item{};
+			if (auto duration = cast<long long>(node, u8"duration"); duration)
+				item.duration = milliseconds{*duration};
+			if (auto failed = cast<bool>(node, u8"failed"); failed)
+				item.failed = *failed;
+			item.rusage = rusage_from_json(cast<json::map>(node, u8"rusage"));
+			records_[from_u8s(key)] = item;
+		}
+	}
+
+	void history::store() const {
+		json::map tests{};
+		for (auto const& [key, item] : records_) {
+			json::map entry{};
+			if (item.duration)
+				entry.set(u8"duration",
+				          static_cast<long long>(item.duration->count()));
+			if (item.failed) entry.set(u8"failed", true);
+			if (item.rusage)
+				entry.set(u8"rusage", rusage_to_json(*item.rusage));
+			tests.set(to_u8s(key), std::move(entry));
+		}
+
+		json::map root{};
+		root.set(u8"tests", std::move(tests));
+
+		std::error_code ec{};
+		fs::create_directories(filename_.parent_path(), ec);
+		if (ec) return;
+
+		json::string text;
+		json::write_json(text, root, json::four_spaces);
+		if (text.empty() || text.back() != u8'\n') text.push_back(u8'\n');
+		auto file = io::fopen(filename_, "wb");
+		if (!file) return;
+		file.store(text.data(), text.size());
+	}
+
+	std::string history::key_for(fs::path const& test_filename) const {
+		return shell::get_generic_path(
+		    test_filename.lexically_relative(root_));
+	}
+
+	std::optional<milliseconds> history::duration(
+	    fs::path const& test_filename) const {
+		auto it = records_.find(key_for(test_filename));
+		if (it == records_.end()) return std::nullopt;
+		return it->second.duration;
+	}
+
+	void history::set_duration(fs::path const& test_filename,
+	                           milliseconds duration) {
+		records_[key_for(test_filename)].duration = duration;
+	}
+
+	std::optional<io::resource_usage> history::rusage(
+	    fs::path const& test_filename) const {
+		auto it = records_.find(key_for(test_filename));
+		if (it == records_.end()) return std::nullopt;
+		return it->second.rusage;
+	}
+
+	void history::set_rusage(fs::path const& test_filename,
+	                         io::resource_usage const& rusage) {
+		records_[key_for(test_filename)].rusage = rusage;
+	}
+
+	bool history::failed(fs::path const& test_filename) const {
+		auto it = records_.find(key_for(test_filename));
+		return it != records_.end() && it->second.failed;
+	}
+
+	void history::set_failed(fs::path const& test_filename, bool failed) {
+		records_[key_for(test_filename)].failed = failed;
+	}
+}  // namespace testbed
@@ -0,0 +1,67 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include "io/resource_usage.hh"
+
+namespace fs = std::filesystem;
+
+namespace testbed {
+	using std::chrono::milliseconds;
+
+	// Per-test timing and outcome database, keyed by the path of the test
+	// file relative to the datasets directory, so it survives moving the
+	// checkout.
+	class history {
+	public:
+		static constexpr auto dirname = ".db";
+
+		struct record {
+			std::optional<milliseconds> duration{};
+			bool failed{false};
+			// of the tested call and its `post` calls, the last time the
+			// test ran them
+			std::optional<io::resource_usage> rusage{};
+		};
+
+		history() = default;
+		history(fs::path const& db_dir, fs::path const& root)
+		    : filename_{db_dir / "history.json"}, root_{root} {}
+
+		// for a database copied from elsewhere, e.g. a CI artifact
+		static history from_file(fs::path const& filename,
+		                         fs::path const& root) {
+			history result{};
+			result.filename_ = filename;
+			result.root_ = root;
+			return result;
+		}
+
+		void load();
+		void store() const;
+
+		std::string key_for(fs::path const& test_filename) const;
+		std::optional<milliseconds> duration(
+		    fs::path const& test_filename) const;
+		void set_duration(fs::path const& test_filename,
+		                  milliseconds duration);
+		std::optional<io::resource_usage> rusage(
+		    fs::path const& test_filename) const;
+		void set_rusage(fs::path const& test_filename,
+		                io::resource_usage const& rusage);
+		// whether the test failed, the last time it ran to completion
+		bool failed(fs::path const& test_filename) const;
+		void set_failed(fs::path const& test_filename, bool failed);
+
+	private:
+		fs::path filename_{};
+		fs::path root_{};
+		std::map<std::string, record> records_{};
+	};
+}  // namespace testbed
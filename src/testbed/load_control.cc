@@ -0,0 +1,98 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/load_control.hh"
+#include <fmt/format.h>
+#include <algorithm>
+#include <utility>
+
+namespace testbed {
+	namespace {
+		// add a job below this share of busy CPU...
+		constexpr double idle_cores = 0.9;
+		// ...unless this share of the time is spent waiting for disks
+		constexpr double io_bound = 0.2;
+		// ...or the tests, which finished, took less than this share of
+		// the CPU their jobs could have used; they wait for something
+		// else, e.g. the network or a sleep, and more of them would not
+		// take the idle cores
+		constexpr double mostly_waiting = 0.25;
+		// runnable threads per core, which count as oversubscription
+		constexpr double overloaded = 1.5;
+		// jobs for each core, at most
+		constexpr size_t max_per_core = 4;
+
+		double share(std::uint64_t part, std::uint64_t total) {
+			return total ? static_cast<double>(part) /
+			                   static_cast<double>(total)
+			             : 0.0;
+		}
+	}  // namespace
+
+	load_control::load_control(size_t cores)
+	    : cores_{std::max(cores, size_t{1})}
+	    , max_jobs_{cores_ * max_per_core}
+	    , jobs_{cores_}
+	    , next_{clock::now()} {}
+
+	bool load_control::update(size_t running) {
+		next_ = clock::now() + period;
+
+		auto const sample = io::sample_load();
+		if (!sample) return false;
+		auto const prev = std::exchange(last_, sample);
+		if (!prev) return false;
+
+		auto const busy = sample->busy - prev->busy;
+		auto const iowait = sample->iowait - prev->iowait;
+		auto const total = busy + iowait + (sample->idle - prev->idle);
+		auto const elapsed =
+		    std::chrono::duration<double>(sample->taken - prev->taken);
+		auto const children =
+		    std::chrono::duration<double>(sample->children - prev->children);
+
+		usage_.cpu = share(busy, total);
+		usage_.iowait = share(iowait, total);
+		usage_.children =
+		    elapsed.count() > 0
+		        ? children.count() /
+		              (elapsed.count() * static_cast<double>(cores_))
+		        : 0.0;
+		usage_.runnable.reset();
+		if (sample->runnable) {
+			usage_.runnable = static_cast<double>(*sample->runnable) /
+			                  static_cast<double>(cores_);
+		}
+
+		auto const previous = jobs_;
+		if (usage_.runnable && *usage_.runnable > overloaded) {
+			// a single sample may catch a burst of short-lived processes
+			if (++strikes_ > 1) {
+				jobs_ = std::max(jobs_ / 2, size_t{1});
+				strikes_ = 0;
+			}
+		} else {
+			strikes_ = 0;
+			// only reaped children are counted, so a period, in which no
+			// test finished, tells nothing about them
+			auto const could_use =
+			    static_cast<double>(std::min(running, cores_)) /
+			    static_cast<double>(cores_);
+			auto const waiting = usage_.children > 0 &&
+			                     usage_.children < mostly_waiting * could_use;
+			if (usage_.cpu < idle_cores && usage_.iowait < io_bound &&
+			    !waiting && running >= jobs_)
+				jobs_ = std::min(jobs_ + 1, max_jobs_);
+		}
+		return jobs_ != previous;
+	}
+
+	std::string load_control::describe() const {
+		auto result = fmt::format(
+		    "cpu {:.0f}%, iowait {:.0f}%, tests {:.0f}%", usage_.cpu * 100,
+		    usage_.iowait * 100, usage_.children * 100);
+		if (usage_.runnable)
+			result += fmt::format(", {:.1f} runnable/core", *usage_.runnable);
+		return result;
+	}
+}  // namespace testbed
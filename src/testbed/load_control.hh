@@ -0,0 +1,50 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include "io/load.hh"
+
+namespace testbed {
+	// Number of jobs for --jobs=auto. Every period the machine is sampled
+	// and, AIMD-style, one job is added while cores stay idle, the disks
+	// keep up and the tests use the CPU they get, or the jobs are halved,
+	// once there are more threads ready to run than cores for a second
+	// sample in a row.
+	class load_control {
+	public:
+		using clock = std::chrono::steady_clock;
+		static constexpr auto period = std::chrono::milliseconds{500};
+
+		explicit load_control(size_t cores);
+
+		size_t jobs() const noexcept { return jobs_; }
+		clock::time_point next_sample() const noexcept { return next_; }
+		bool due() const noexcept { return clock::now() >= next_; }
+
+		// Samples the machine; true, if the number of jobs changed. Jobs
+		// are only added, if all of them are taken by running tests.
+		bool update(size_t running);
+		// the last sample, for the log
+		std::string describe() const;
+
+	private:
+		struct usage {
+			double cpu{};
+			double iowait{};
+			double children{};
+			std::optional<double> runnable{};
+		};
+
+		size_t cores_{1};
+		size_t max_jobs_{1};
+		size_t jobs_{1};
+		unsigned strikes_{};
+		clock::time_point next_{};
+		std::optional<io::load_sample> last_{};
+		usage usage_{};
+	};
+}  // namespace testbed
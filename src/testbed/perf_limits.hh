@@ -0,0 +1,66 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "io/resource_usage.hh"
+
+namespace testbed {
+	// Resource budget of the tested call, together with its "post" calls;
+	// a test over any of them fails, even with the expected output. Names
+	// of the fields are the keys of the "limits" in the test file.
+	struct perf_limits {
+		std::optional<size_t> wall_ms{};
+		std::optional<size_t> user_ms{};
+		std::optional<size_t> system_ms{};
+		std::optional<size_t> max_rss_kb{};
+
+		struct breach {
+			std::string_view name{};
+			double measured{};
+			size_t budget{};
+		};
+
+		// nullptr for names other than wall_ms, user_ms, system_ms and
+		// max_rss_kb
+		std::optional<size_t>* field(std::string_view name) noexcept {
+			if (name == "wall_ms") return &wall_ms;
+			if (name == "user_ms") return &user_ms;
+			if (name == "system_ms") return &system_ms;
+			if (name == "max_rss_kb") return &max_rss_kb;
+			return nullptr;
+		}
+
+		std::vector<breach> check(io::resource_usage const& usage) const {
+			std::vector<breach> result{};
+			auto const time = [&](std::string_view name,
+			                      std::optional<size_t> const& budget,
+			                      io::microseconds measured) {
+				using std::chrono::milliseconds;
+				if (!budget ||
+				    measured <= milliseconds{
+				                    static_cast<milliseconds::rep>(*budget)})
+					return;
+				result.push_back(
+				    {name,
+				     std::chrono::duration<double, std::milli>{measured}
+				         .count(),
+				     *budget});
+			};
+			time("wall_ms", wall_ms, usage.wall);
+			time("user_ms", user_ms, usage.user);
+			time("system_ms", system_ms, usage.system);
+			if (max_rss_kb && usage.max_rss_kb > *max_rss_kb) {
+				result.push_back({"max_rss_kb",
+				                  static_cast<double>(usage.max_rss_kb),
+				                  *max_rss_kb});
+			}
+			return result;
+		}
+	};
+}  // namespace testbed
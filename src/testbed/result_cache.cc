@@ -0,0 +1,232 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/result_cache.hh"
+#include <fmt/format.h>
+#include <algorithm>
+#include <json/json.hpp>
+#include <set>
+#include <vector>
+#include "base/fnv1a.hh"
+#include "base/shell.hh"
+#include "base/str.hh"
+#include "io/file.hh"
+#include "testbed/test.hh"
+
+using namespace std::literals;
+
+namespace testbed {
+	namespace {
+		constexpr auto missing = "<missing>"sv;
+
+		std::uint64_t read_hash(fs::path const& path) {
+			auto file = io::fopen(path, "rb");
+			if (!file) return fnv1a::of(missing);
+
+			fnv1a result{};
+			char buffer[16384];
+			while (auto const length = file.load(buffer, sizeof(buffer)))
+				result.update(buffer, length);
+			return result.value();
+		}
+
+		std::string_view command_of(strlist const& cmd) {
+			if (cmd.empty()) return {};
+			std::string_view name = cmd.front();
+			static constexpr auto safe_ = "safe-"sv;
+			if (name.starts_with(safe_)) name = name.substr(safe_.length());
+			return name;
+		}
+
+		// commands, which copy or unpack their first argument into the
+		// test directory
+		bool reads_fixture(std::string_view command) {
+			return command == "cp"sv || command == "unpack"sv ||
+			       command == "generate"sv;
+		}
+	}  // namespace
+
+	void result_cache::load() {
+		std::lock_guard lock{m_};
+		passed_.clear();
+
+		auto file = io::fopen(filename_);
+		if (!file) return;
+		auto data = file.read();
+		auto root = json::read_json(
+		    {reinterpret_cast<char8_t const*>(data.data()), data.size()});
+
+		auto tests = cast<json::map>(root, u8"passed");
+		if (!tests) return;
+
+		for (auto const& [key, node] : tests->items()) {
+			auto hash = cast<json::string>(node);
+			if (hash) passed_[from_u8s(key)] = from_u8s(*hash);
+		}
+	}
+
+	void result_cache::store() const {
+		json::map tests{};
+		{
+			std::lock_guard lock{m_};
+			for (auto const& [key, hash] : passed_)
+				tests.set(to_u8s(key), to_u8s(hash));
+		}
+
+		json::map root{};
+		root.set(u8"passed", std::move(tests));
+
+		std::error_code ec{};
+		fs::create_directories(filename_.parent_path(), ec);
+		if (ec) return;
+
+		json::string text;
+		json::write_json(text, root, json::four_spaces);
+		if (text.empty() || text.back() != u8'\n') text.push_back(u8'\n');
+		auto file = io::fopen(filename_, "wb");
+		if (!file) return;
+		file.store(text.data(), text.size());
+	}
+
+	void result_cache::prepare(runtime const& rt,
+	                           fs::path const& script,
+	                           std::string_view salt) {
+		{
+			// a new pass; with --watch, any of the files might have
+			// changed since the previous one
+			std::lock_guard lock{m_};
+			files_.clear();
+		}
+
+		fnv1a hash{};
+		hash.field(salt);
+		hash.field(shell::get_generic_path(rt.rt_target));
+		hash.update(file_hash(rt.rt_target));
+		hash.update(file_hash(script));
+		if (rt.common_patches) {
+			for (auto const& [expr, replacement] : *rt.common_patches)
+				hash.field(expr).field(replacement);
+		}
+		// a shorter budget, or a lower limit, may turn a pass into
+		// a failure
+		for (auto const& budget : {rt.timeout.prepare, rt.timeout.run,
+		                           rt.timeout.post, rt.timeout.cleanup}) {
+			hash.update(budget ? static_cast<std::uint64_t>(budget->count())
+			                   : ~std::uint64_t{});
+		}
+		hash.update(std::uint64_t{rt.capture_limit});
+		common_ = hash.value();
+	}
+
+	std::string result_cache::key_for(test const& tested,
+	                                  io::env_block const& variables,
+	                                  runtime const& rt) {
+		fnv1a hash{};
+		hash.update(common_);
+		hash.field(name_for(tested.filename));
+		hash.update(read_hash(tested.filename));
+
+		// only the variables set by the test, or by runner.chai; the rest
+		// of the inherited environment, like OLDPWD, SHLVL or _, changes
+		// with every shell
+		auto const block = tested.copy_environment_block(variables, rt);
+		std::set<std::string_view> names{"LANGUAGE"sv};
+		for (auto const& [name, _] : tested.env)
+			names.insert(name);
+		for (auto const& name : rt.reportable_vars)
+			names.insert(name);
+		for (auto const name : names) {
+			auto const value = block.get(name);
+			hash.field(name).field(value ? *value : missing);
+		}
+
+		// follows the `cd`s of the prepare commands, so the relative
+		// fixtures are found where the commands will look for them
+		auto cwd = tested.cwd();
+		for (auto const& cmd : tested.prepare) {
+			if (cmd.size() < 2) continue;
+			auto const command = command_of(cmd);
+			if (command == "mock"sv) {
+				hash.update(file_hash(rt.build_dir / "mocks"sv / cmd[1]));
+				continue;
+			}
+			if (command != "cd"sv && !reads_fixture(command)) continue;
+
+			auto const arg = shell::make_u8path(
+			    rt.expand(cmd[1], tested.stored_env, exp::generic));
+			if (command == "cd"sv)
+				cwd /= arg;
+			else
+				hash.update(tree_hash(cwd / arg));
+		}
+
+		// the prepare commands have moved into the final directory by now
+		if (tested.input.file) {
+			auto const arg = shell::make_u8path(
+			    rt.expand(*tested.input.file, tested.stored_env, exp::generic));
+			hash.update(tree_hash(cwd / arg));
+		}
+
+		return fmt::format("{:016x}", hash.value());
+	}
+
+	bool result_cache::passed(fs::path const& test_filename,
+	                          std::string const& key) const {
+		auto const name = name_for(test_filename);
+		std::lock_guard lock{m_};
+		auto it = passed_.find(name);
+		return it != passed_.end() && it->second == key;
+	}
+
+	void result_cache::set_passed(fs::path const& test_filename,
+	                              std::string key) {
+		auto name = name_for(test_filename);
+		std::lock_guard lock{m_};
+		passed_[std::move(name)] = std::move(key);
+	}
+
+	void result_cache::forget(fs::path const& test_filename) {
+		auto const name = name_for(test_filename);
+		std::lock_guard lock{m_};
+		passed_.erase(name);
+	}
+
+	std::string result_cache::name_for(fs::path const& test_filename) const {
+		return shell::get_generic_path(
+		    test_filename.lexically_relative(root_));
+	}
+
+	std::uint64_t result_cache::file_hash(fs::path const& path) {
+		{
+			std::lock_guard lock{m_};
+			auto it = files_.find(path);
+			if (it != files_.end()) return it->second;
+		}
+
+		// two tests may hash the same file at once; both get the same value
+		auto const result = read_hash(path);
+		std::lock_guard lock{m_};
+		files_[path] = result;
+		return result;
+	}
+
+	std::uint64_t result_cache::tree_hash(fs::path const& path) {
+		std::error_code ec{};
+		if (!fs::is_directory(path, ec)) return file_hash(path);
+
+		std::vector<fs::path> entries{};
+		for (auto const& entry :
+		     fs::recursive_directory_iterator{path, ec}) {
+			if (entry.is_regular_file(ec)) entries.push_back(entry.path());
+		}
+		std::sort(entries.begin(), entries.end());
+
+		fnv1a hash{};
+		for (auto const& entry : entries) {
+			hash.field(
+			    shell::get_generic_path(entry.lexically_relative(path)));
+			hash.update(file_hash(entry));
+		}
+		return hash.value();
+	}
+}  // namespace testbed
@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "io/env_block.hh"
+
+namespace fs = std::filesystem;
+
+namespace testbed {
+	struct runtime;
+	struct test;
+
+	// Content-addressed record of passing runs, kept next to the history.
+	// The key of a run hashes everything the test reads: its JSON file,
+	// the target, `runner.chai`, the variables set by the test and by the
+	// runtime, the mocks and the fixtures named by the prepare commands,
+	// the common patches, the timeouts and the capture limit. A test,
+	// whose key did not change since it last passed, needs not run.
+	class result_cache {
+	public:
+		result_cache() = default;
+		result_cache(fs::path const& db_dir, fs::path const& root)
+		    : filename_{db_dir / "cache.json"}, root_{root} {}
+
+		void load();
+		void store() const;
+
+		// Hashes the inputs shared by all the tests, forgetting the file
+		// hashes of the previous pass; the salt is there to forget every
+		// result after an update of the runner itself.
+		void prepare(runtime const& rt,
+		             fs::path const& script,
+		             std::string_view salt);
+		std::string key_for(test const& tested,
+		                    io::env_block const& variables,
+		                    runtime const& rt);
+
+		bool passed(fs::path const& test_filename,
+		            std::string const& key) const;
+		void set_passed(fs::path const& test_filename, std::string key);
+		void forget(fs::path const& test_filename);
+
+	private:
+		std::string name_for(fs::path const& test_filename) const;
+		std::uint64_t file_hash(fs::path const& path);
+		std::uint64_t tree_hash(fs::path const& path);
+
+		fs::path filename_{};
+		fs::path root_{};
+		std::uint64_t common_{};
+		mutable std::mutex m_{};
+		std::map<std::string, std::string> passed_{};
+		std::map<fs::path, std::uint64_t> files_{};
+	};
+}  // namespace testbed
@@ -100,13 +100,13 @@ namespace testbed {
 		return result;
 	}
 
-	bool runtime::run(commands& handler,
-	                  std::span<std::string const> args,
-	                  std::string& listing) const {
+	mt::co_task<bool> runtime::run(commands& handler,
+	                               std::span<std::string const> args,
+	                               std::string& listing) const {
 		if (args.empty()) {
 			listing.append(
 			    fmt::format("\033[1;31merror: command not provided\033[m\n"));
-			return false;
+			co_return false;
 		}
 
 		auto const& orig = args.front();
@@ -129,27 +129,32 @@ namespace testbed {
 			    fmt::format("\033[1;31merror: command `{}` not found "
 			                "\033[1;37m[{}]\033[m\n",
 			                args.front(), shell::join(args)));
-			return false;
+			co_return false;
 		}
-		auto [min, call] = it->second;
+		auto const& info = it->second;
 		args = args.subspan(1);
-		if (args.size() < min) {
+		if (args.size() < info.min_args) {
 			listing.append(fmt::format(
 			    "\033[1;31merror: command `{}` expects {}, got {} "
 			    "argument{}\033[m\n",
-			    args.front(), min, args.size(), args.size() == 1 ? "" : "s"));
-			return false;
+			    args.front(), info.min_args, args.size(),
+			    args.size() == 1 ? "" : "s"));
+			co_return false;
 		}
-		auto const result = call(handler, args, listing);
+		bool result{false};
+		if (info.async_handler)
+			result = co_await info.async_handler(handler, args, listing);
+		else
+			result = info.handler(handler, args, listing);
 		if (!result) {
 			if (!can_fail || command != "rm"sv) {
 				listing.append(fmt::format(
 				    "\033[1;31merror: problem while handling `{} {}`\033[m\n",
 				    orig, shell::join(args)));
 			}
-			return can_fail;
+			co_return can_fail;
 		}
-		return result;
+		co_return result;
 	}
 
 	std::string expand(std::string_view input, std::smatch const& m) {
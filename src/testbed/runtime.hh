@@ -5,6 +5,7 @@
 
 #include <set>
 #include "testbed/commands.hh"
+#include "testbed/timeouts.hh"
 
 namespace testbed {
 	enum class exp { generic, preferred, not_changed };
@@ -22,9 +23,24 @@ namespace testbed {
 		std::map<std::string, std::string>* variables;
 		std::map<std::string, std::string> const* chai_variables;
 		std::map<std::string, std::string> const* common_patches;
+		timeouts timeout{};
+		// bytes of each stream of the tested call kept in memory; the
+		// rest goes to spill_dir(), zero keeps everything
+		size_t capture_limit{};
 		bool debug{true};
 
 		fs::path mocks_dir() const { return temp_dir / "mocks"sv; }
+		// next to the temp dir, never inside, where the test could see it
+		fs::path spill_dir() const { return spill_dir_for(temp_dir); }
+		static fs::path spill_dir_for(fs::path const& temp_dir) {
+			auto name = temp_dir.filename();
+			name += ".spill"sv;
+			return temp_dir.parent_path() / name;
+		}
+		void set_counter_total(size_t total) noexcept {
+			counter_total = total;
+			counter_digits = counter_width(total);
+		}
 
 		std::string expand(std::string const& arg,
 		                   std::map<std::string, std::string> const& stored_env,
@@ -33,9 +49,9 @@ namespace testbed {
 		    std::span<std::string const> cmd,
 		    std::map<std::string, std::string> const& stored_env,
 		    exp modifier) const;
-		bool run(commands& handler,
-		         std::span<std::string const> args,
-		         std::string& listing) const;
+		mt::co_task<bool> run(commands& handler,
+		                      std::span<std::string const> args,
+		                      std::string& listing) const;
 		void fix(std::string& text,
 		         std::vector<std::pair<std::string, std::string>> const&
 		             patches) const;
@@ -0,0 +1,89 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/schedule.hh"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include "testbed/dispatcher.hh"
+#include "testbed/test.hh"
+
+namespace testbed {
+	std::vector<planned_test> estimate(std::span<test* const> tests,
+	                                   history const& db) {
+		std::vector<planned_test> result{};
+		result.reserve(tests.size());
+
+		milliseconds known{};
+		milliseconds::rep known_count{};
+		for (auto tested : tests) {
+			auto const duration = db.duration(tested->filename);
+			if (duration) {
+				known += *duration;
+				++known_count;
+			}
+			result.push_back({.item = tested,
+			                  .estimate = duration.value_or(milliseconds{}),
+			                  .measured = duration.has_value()});
+		}
+
+		if (known_count) {
+			auto const average = known / known_count;
+			for (auto& planned : result) {
+				if (!planned.measured) planned.estimate = average;
+			}
+		}
+
+		return result;
+	}
+
+	std::vector<planned_test> longest_first(std::span<test* const> tests,
+	                                        history const& db) {
+		auto result = estimate(tests, db);
+		std::stable_sort(result.begin(), result.end(),
+		                 [](planned_test const& lhs, planned_test const& rhs) {
+			                 return lhs.estimate > rhs.estimate;
+		                 });
+		return result;
+	}
+
+	void failed_first(std::vector<planned_test>& order, history const& db) {
+		std::stable_partition(order.begin(), order.end(),
+		                      [&db](planned_test const& planned) {
+			                      return db.failed(planned.item->filename);
+		                      });
+	}
+
+	milliseconds makespan(std::span<planned_test const> order,
+	                      size_t jobs,
+	                      std::map<std::string, unsigned> const& capacities,
+	                      bool all_linear) {
+		using finish_time = std::pair<milliseconds, size_t>;
+
+		dispatcher queue{order, jobs, capacities, all_linear};
+		std::priority_queue<finish_time, std::vector<finish_time>,
+		                    std::greater<>>
+		    running{};
+
+		milliseconds now{};
+		while (true) {
+			for (auto const& planned : queue.start_next())
+				running.push({now + planned.estimate, planned.item->index});
+			if (running.empty()) break;
+
+			auto const [end, index] = running.top();
+			running.pop();
+			now = end;
+			queue.finished(index);
+		}
+
+		return now;
+	}
+
+	milliseconds total(std::span<planned_test const> order) {
+		milliseconds result{};
+		for (auto const& planned : order)
+			result += planned.estimate;
+		return result;
+	}
+}  // namespace testbed
@@ -0,0 +1,43 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+#include "testbed/history.hh"
+
+namespace testbed {
+	struct test;
+
+	struct planned_test {
+		test* item{};
+		milliseconds estimate{};
+		bool measured{false};
+	};
+
+	// Tests never timed before are estimated with the average of the timed
+	// ones; the result keeps the order of the input.
+	std::vector<planned_test> estimate(std::span<test* const> tests,
+	                                   history const& db);
+
+	// Longest processing time first: the longest tests are started first,
+	// so that the short ones can fill the gaps at the end of the run.
+	std::vector<planned_test> longest_first(std::span<test* const> tests,
+	                                        history const& db);
+
+	// Moves the tests, which failed in the previous run, to the front,
+	// keeping the order within both groups.
+	void failed_first(std::vector<planned_test>& order, history const& db);
+
+	// Wall time of the schedule, replayed through the dispatcher with the
+	// estimates standing in for the real run times.
+	milliseconds makespan(std::span<planned_test const> order,
+	                      size_t jobs,
+	                      std::map<std::string, unsigned> const& capacities,
+	                      bool all_linear);
+
+	milliseconds total(std::span<planned_test const> order);
+}  // namespace testbed
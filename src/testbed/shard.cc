@@ -0,0 +1,88 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testbed/shard.hh"
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include "base/fnv1a.hh"
+#include "testbed/schedule.hh"
+#include "testbed/test.hh"
+
+namespace testbed {
+	namespace {
+		std::optional<unsigned> number(std::string_view text) {
+			unsigned result{};
+			auto const end = text.data() + text.size();
+			auto const [ptr, ec] = std::from_chars(text.data(), end, result);
+			if (ec != std::errc{} || ptr != end) return std::nullopt;
+			return result;
+		}
+
+		// restores the order of the tests, so the shard runs just like the
+		// unsharded suite would
+		void by_index(std::vector<test*>& tests) {
+			std::sort(tests.begin(), tests.end(),
+			          [](test const* lhs, test const* rhs) {
+				          return lhs->index < rhs->index;
+			          });
+		}
+	}  // namespace
+
+	std::optional<shard> shard::parse(std::string_view spec) {
+		auto const slash = spec.find('/');
+		if (slash == std::string_view::npos) return std::nullopt;
+		auto const index = number(spec.substr(0, slash));
+		auto const count = number(spec.substr(slash + 1));
+		if (!index || !count || !*count || !*index || *index > *count)
+			return std::nullopt;
+		return shard{.index = *index, .count = *count};
+	}
+
+	std::vector<test*> hashed_shard(std::span<test* const> tests,
+	                                shard const& slice,
+	                                history const& keys) {
+		std::vector<test*> result{};
+		for (auto tested : tests) {
+			auto const hash = fnv1a::of(keys.key_for(tested->filename));
+			if (hash % slice.count == slice.index - 1)
+				result.push_back(tested);
+		}
+		return result;
+	}
+
+	std::vector<test*> balanced_shard(std::span<test* const> tests,
+	                                  shard const& slice,
+	                                  history const& timings) {
+		struct keyed {
+			planned_test planned;
+			std::string key;
+		};
+
+		std::vector<keyed> order{};
+		order.reserve(tests.size());
+		for (auto const& planned : estimate(tests, timings))
+			order.push_back({planned, timings.key_for(planned.item->filename)});
+
+		// ties are broken by the key, not by the order of discovery, so a
+		// machine with a different checkout path still agrees
+		std::sort(order.begin(), order.end(),
+		          [](keyed const& lhs, keyed const& rhs) {
+			          if (lhs.planned.estimate != rhs.planned.estimate)
+				          return lhs.planned.estimate > rhs.planned.estimate;
+			          return lhs.key < rhs.key;
+		          });
+
+		std::vector<milliseconds> load(slice.count);
+		std::vector<test*> result{};
+		for (auto const& [planned, _] : order) {
+			auto const lightest = static_cast<unsigned>(
+			    std::min_element(load.begin(), load.end()) - load.begin());
+			load[lightest] += planned.estimate;
+			if (lightest == slice.index - 1) result.push_back(planned.item);
+		}
+
+		by_index(result);
+		return result;
+	}
+}  // namespace testbed
@@ -0,0 +1,37 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "testbed/history.hh"
+
+namespace testbed {
+	struct test;
+
+	// One of `count` slices of the suite, with `index` counted from one,
+	// as in `--shard 3/8`.
+	struct shard {
+		unsigned index{1};
+		unsigned count{1};
+
+		static std::optional<shard> parse(std::string_view spec);
+	};
+
+	// Picks the tests, whose path relative to the datasets directory hashes
+	// into this shard. A test stays in its shard no matter which other
+	// tests are added or removed.
+	std::vector<test*> hashed_shard(std::span<test* const> tests,
+	                                shard const& slice,
+	                                history const& keys);
+
+	// Deals the tests, longest first, to the least loaded shard, using
+	// durations from `timings`. All the machines need to see the same
+	// timings to come up with the same partition.
+	std::vector<test*> balanced_shard(std::span<test* const> tests,
+	                                  shard const& slice,
+	                                  history const& timings);
+}  // namespace testbed
@@ -3,6 +3,9 @@
 
 #include "testbed/test.hh"
 #include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include "base/diff.hh"
 #include "base/shell.hh"
 #include "base/str.hh"
@@ -64,6 +67,157 @@ namespace testbed {
 			return result;
 		}
 
+		std::optional<resource_map> resources_from_json(json::map const& root) {
+			resource_map result{};
+			auto it = root.find(u8"resources");
+			if (it == root.end()) return result;
+
+			auto map = cast<json::map>(it->second);
+			if (!map) return std::nullopt;
+			for (auto const& [key, value] : map->items()) {
+				auto const count = cast<long long>(value);
+				if (!count || *count < 1) return std::nullopt;
+				result[from_u8s(key)] = static_cast<unsigned>(*count);
+			}
+
+			return result;
+		}
+
+		std::optional<io::terminal> terminal_from_json(json::map const& root) {
+			io::terminal result{};
+			auto it = root.find(u8"terminal");
+			if (it == root.end()) return result;
+
+			auto map = cast<json::map>(it->second);
+			if (!map) return std::nullopt;
+			for (auto const& [key, value] : map->items()) {
+				auto const size = cast<long long>(value);
+				if (!size || *size < 1 || *size > USHRT_MAX)
+					return std::nullopt;
+				auto const dim = static_cast<unsigned short>(*size);
+				if (key == u8"columns"sv)
+					result.columns = dim;
+				else if (key == u8"rows"sv)
+					result.rows = dim;
+				else
+					return std::nullopt;
+			}
+
+			return result;
+		}
+
+		std::optional<test_data::input_t> input_from_json(
+		    json::map const& root) {
+			test_data::input_t result{};
+			auto it = root.find(u8"stdin");
+			if (it == root.end()) return result;
+
+			if (auto text = cast<json::string>(it->second); text) {
+				result.text = from_u8s(*text);
+				return result;
+			}
+
+			auto map = cast<json::map>(it->second);
+			if (!map) return std::nullopt;
+			for (auto const& [key, value] : map->items()) {
+				auto const file = cast<json::string>(value);
+				if (key != u8"file"sv || !file) return std::nullopt;
+				result.file = from_u8s(*file);
+			}
+			if (!result.file) return std::nullopt;
+
+			return result;
+		}
+
+		using deadline = std::optional<std::chrono::steady_clock::time_point>;
+
+		deadline deadline_after(
+		    std::optional<std::chrono::milliseconds> const& budget) {
+			if (!budget) return std::nullopt;
+			return std::chrono::steady_clock::now() + *budget;
+		}
+
+		std::optional<std::chrono::milliseconds> remaining(
+		    deadline const& point) {
+			if (!point) return std::nullopt;
+			return std::max(
+			    std::chrono::duration_cast<std::chrono::milliseconds>(
+			        *point - std::chrono::steady_clock::now()),
+			    std::chrono::milliseconds::zero());
+		}
+
+		double as_ms(io::microseconds time) {
+			return std::chrono::duration<double, std::milli>(time).count();
+		}
+
+		std::string describe(io::resource_usage const& usage) {
+			return fmt::format(
+			    "\033[0;33m"
+			    "  wall {:.1f} ms, user {:.1f} ms, sys {:.1f} ms, "
+			    "max rss {} KiB, faults {}/{} (minor/major), "
+			    "switches {}/{} (voluntary/involuntary)\033[m\n",
+			    as_ms(usage.wall), as_ms(usage.user), as_ms(usage.system),
+			    usage.max_rss_kb, usage.minor_faults, usage.major_faults,
+			    usage.voluntary_switches, usage.involuntary_switches);
+		}
+
+		std::optional<std::chrono::milliseconds> budget_from_json(
+		    json::node const& node) {
+			std::chrono::duration<double> seconds{};
+			if (auto const integer = cast<long long>(node); integer)
+				seconds = std::chrono::duration<double>(
+				    static_cast<double>(*integer));
+			else if (auto const real = cast<double>(node); real)
+				seconds = std::chrono::duration<double>(*real);
+			else
+				return std::nullopt;
+
+			if (seconds.count() <= 0) return std::nullopt;
+			return std::chrono::duration_cast<std::chrono::milliseconds>(
+			    seconds);
+		}
+
+		// "timeout": seconds for each phase, or {"run": seconds, ...}
+		std::optional<timeouts> timeouts_from_json(json::map const& root) {
+			timeouts result{};
+			auto it = root.find(u8"timeout");
+			if (it == root.end()) return result;
+
+			if (auto const budget = budget_from_json(it->second); budget)
+				return timeouts::all(*budget);
+
+			auto map = cast<json::map>(it->second);
+			if (!map) return std::nullopt;
+
+			for (auto const& [key, value] : map->items()) {
+				auto const phase = result.phase(from_u8s(key));
+				if (!phase) return std::nullopt;
+				*phase = budget_from_json(value);
+				if (!*phase) return std::nullopt;
+			}
+
+			return result;
+		}
+
+		// "limits": {"wall_ms": 200, "max_rss_kb": 65536, ...}
+		std::optional<perf_limits> limits_from_json(json::map const& root) {
+			perf_limits result{};
+			auto it = root.find(u8"limits");
+			if (it == root.end()) return result;
+
+			auto map = cast<json::map>(it->second);
+			if (!map) return std::nullopt;
+
+			for (auto const& [key, value] : map->items()) {
+				auto const field = result.field(from_u8s(key));
+				auto const budget = cast<long long>(value);
+				if (!field || !budget || *budget <= 0) return std::nullopt;
+				*field = static_cast<size_t>(*budget);
+			}
+
+			return result;
+		}
+
 		std::map<std::string, test_variable> env_variables(
 		    json::map const& root) {
 			std::map<std::string, test_variable> result{};
@@ -193,6 +347,60 @@ namespace testbed {
 			ok = true;
 			return result;
 		}
+
+		using patch_list = std::vector<std::pair<std::string, std::string>>;
+
+		constexpr size_t read_back_chunk = 64 * 1024;
+
+		// Patched lines from the start of a spilled stream, until there
+		// are more than `need` bytes of them; true, if the whole stream
+		// was read.
+		bool patched_head(io::spilled const& file,
+		                  size_t need,
+		                  runtime const& rt,
+		                  patch_list const& patches,
+		                  std::string& dst) {
+			dst.clear();
+			size_t offset{};
+			while (offset < file.size && dst.size() <= need) {
+				auto block = io::read_spilled(file, offset, read_back_chunk);
+				if (block.empty()) break;
+				// whole lines only, the patches work on lines
+				if (offset + block.size() < file.size) {
+					auto const eol = block.rfind('\n');
+					if (eol != std::string::npos) block.resize(eol + 1);
+				}
+				offset += block.size();
+				rt.fix(block, patches);
+				dst.append(block);
+			}
+			return offset >= file.size;
+		}
+
+		// Patched lines from the end of a spilled stream, at least `need`
+		// bytes of them, if there are that many; true, if the whole stream
+		// was read.
+		bool patched_tail(io::spilled const& file,
+		                  size_t need,
+		                  runtime const& rt,
+		                  patch_list const& patches,
+		                  std::string& dst) {
+			size_t window{};
+			while (true) {
+				window = std::min(std::max(window * 2, need + read_back_chunk),
+				                  file.size);
+				auto const offset = file.size - window;
+				dst = io::read_spilled(file, offset, window);
+				// the first line is most likely cut
+				if (offset) {
+					auto const eol = dst.find('\n');
+					if (eol != std::string::npos) dst.erase(0, eol + 1);
+				}
+				rt.fix(dst, patches);
+				if (!offset) return true;
+				if (dst.size() >= need) return false;
+			}
+		}
 	}  // namespace
 
 	struct select_env {
@@ -205,16 +413,17 @@ namespace testbed {
 		~select_env() { tgt->current_rt = saved; }
 	};
 
-	bool test::run_cmds(runtime const& rt,
-	                    std::span<strlist const> commands,
-	                    std::string& listing) {
+	mt::co_task<bool> test::run_cmds(runtime const& rt,
+	                                 std::span<strlist const> commands,
+	                                 std::string& listing) {
 		select_env from{this, &rt};
 
 		for (auto const& cmd : commands) {
 			auto expanded = rt.expand(cmd, stored_env, exp::generic);
-			if (!rt.run(*this, expanded.stg, listing)) return false;
+			if (!co_await rt.run(*this, expanded.stg, listing)) co_return false;
+			if (timed_out()) co_return false;
 		}
-		return true;
+		co_return true;
 	}
 
 	std::string test_data::name_for(std::string_view name) {
@@ -312,6 +521,11 @@ namespace testbed {
 		auto expected = expected_from_json(it->second, ok);
 		if (!ok) return {.filename = filename, .ok{false}};
 
+		auto const pty = terminal_from_json(*root_map);
+		if (!pty) return {.filename = filename, .ok{false}};
+		auto input = input_from_json(*root_map);
+		if (!input) return {.filename = filename, .ok{false}};
+
 		out_capture_t out_capture{.output = io::piped{}, .error = io::piped{}};
 		if (auto it = root_map->find(u8"output"); it != root_map->end()) {
 			static constexpr auto out_pty = u8"pty"sv;
@@ -320,7 +534,7 @@ namespace testbed {
 			static constexpr auto out_stdout = u8"stdout"sv;
 			if (auto output = cast<json::string>(it->second); output) {
 				if (*output == out_pty) {
-					out_capture.output = io::terminal{};
+					out_capture.output = *pty;
 					out_capture.error = io::redir_to_output{};
 				} else if (*output == out_stderr) {
 					out_capture.output = io::redir_to_error{};
@@ -333,16 +547,16 @@ namespace testbed {
 			} else if (auto obj = cast<json::map>(it->second); obj) {
 				if (auto out = cast<json::string>(obj, u8"stdout"); out) {
 					if (*out == out_pty)
-						out_capture.output = io::terminal{};
+						out_capture.output = *pty;
 					else if (*out == out_stderr)
 						out_capture.output = io::redir_to_error{};
 					else
 						ok = *out == out_pipe;
 				}
 
-				if (auto err = cast<json::string>(obj, u8"stdout"); err) {
+				if (auto err = cast<json::string>(obj, u8"stderr"); err) {
 					if (*err == out_pty)
-						out_capture.error = io::terminal{};
+						out_capture.error = *pty;
 					else if (*err == out_stdout)
 						out_capture.error = io::redir_to_output{};
 					else
@@ -356,6 +570,12 @@ namespace testbed {
 
 		auto lang = get(root_map, u8"lang", "en"sv);
 		auto const linear = get(root_map, u8"linear", false);
+		auto resources = resources_from_json(*root_map);
+		if (!resources) return {.filename = filename, .ok{false}};
+		auto const timeout = timeouts_from_json(*root_map);
+		if (!timeout) return {.filename = filename, .ok{false}};
+		auto const limits = limits_from_json(*root_map);
+		if (!limits) return {.filename = filename, .ok{false}};
 		auto const disabled = get_disabled(root_map);
 		auto env = testbed::env_variables(*root_map);
 		auto patches = testbed::patches(*root_map);
@@ -377,11 +597,15 @@ namespace testbed {
 		    .cleanup = std::move(cleanup),
 		    .expected = std::move(expected),
 		    .linear = linear,
+		    .resources = std::move(*resources),
+		    .timeout = *timeout,
+		    .limits = *limits,
 		    .disabled = disabled,
 		    .env = std::move(env),
 		    .patches = std::move(patches),
 		    .check = check,
 		    .out_capture = out_capture,
+		    .input = std::move(*input),
 		};
 	}
 
@@ -398,40 +622,48 @@ namespace testbed {
 		return result;
 	}
 
-	std::map<std::string, std::string> test::copy_environment_block(
-	    std::map<std::string, std::string> const& variables,
-	    runtime const& rt) const {
+	io::env_block test::copy_environment_block(io::env_block const& variables,
+	                                           runtime const& rt) const {
 		auto result = variables;
-		result["LANGUAGE"] = lang;
+		result.set("LANGUAGE"s, lang);
 		for (auto const& [key, value] : env) {
 			if (std::holds_alternative<std::nullptr_t>(value)) {
 				result.erase(key);
 			} else if (std::holds_alternative<std::string>(value)) {
-				result[key] = rt.expand(std::get<std::string>(value),
-				                        stored_env, exp::preferred);
+				result.set(key, rt.expand(std::get<std::string>(value),
+				                          stored_env, exp::preferred));
 			} else if (std::holds_alternative<std::vector<std::string>>(
 			               value)) {
 				auto const& vars = std::get<std::vector<std::string>>(value);
 				for (auto const& var : vars) {
-					shell::append(result, key,
-					              rt.expand(var, stored_env, exp::preferred));
+					result.append(key,
+					              shell::get_u8path(rt.expand(
+					                  var, stored_env, exp::preferred)),
+					              shell::pathsep);
 				}
 			}
 		}
 		if (needs_mocks_in_path) {
-			shell::prepend(result, "PATH"s, rt.mocks_dir());
+			result.prepend("PATH"s, shell::get_u8path(rt.mocks_dir()),
+			               shell::pathsep);
 		}
 
 		return result;
 	}
 
-	io::capture test::observe(
+	std::optional<fs::path> test::stdin_file(runtime const& rt) const {
+		if (!input.file) return std::nullopt;
+		return cwd() / shell::make_u8path(
+		                   rt.expand(*input.file, stored_env, exp::preferred));
+	}
+
+	mt::co_task<io::capture> test::observe(
 	    std::pair<io::args_storage, std::vector<io::args_storage>>& calls,
-	    std::map<std::string, std::string> const& variables,
+	    io::env_block const& variables,
 	    runtime const& rt,
-	    std::string& listing) const {
-		auto run_cwd = linear ? nullptr : &cwd();
-
+	    timeouts const& budget,
+	    std::string& listing,
+	    std::string_view& timed_out_in) const {
 		if (rt.debug) {
 			listing.append(
 			    fmt::format("\033[1;33m"
@@ -440,16 +672,43 @@ namespace testbed {
 			                shell::join(calls.first.stg)));
 		}
 
-		auto result = io::run({
+		std::optional<io::spill_opts> spill{};
+		// the directory is created by the first stream to outgrow the
+		// limit
+		if (rt.capture_limit)
+			spill = io::spill_opts{rt.capture_limit, rt.spill_dir()};
+
+		auto const input_file = stdin_file(rt);
+		auto result = co_await mt::process{{
 		    .exec = rt.rt_target,
 		    .args = calls.first.args(),
-		    .cwd = run_cwd,
+		    .cwd = &cwd(),
 		    .env = &variables,
+		    .input = input.text,
+		    .input_file = input_file ? &*input_file : nullptr,
 		    .output = out_capture.output,
 		    .error = out_capture.error,
+		    .spill = spill,
 		    .debug = &listing,
-		});
+		    .timeout = budget.run,
+		}};
+		if (result.timed_out) timed_out_in = "run"sv;
+
+		auto const concat = [](std::string& stream,
+		                       std::optional<io::spilled>& spilled,
+		                       std::string const& next) {
+			if (next.empty()) return;
+			if (spilled) {
+				// the memory keeps only the head of the tested call
+				io::append_spilled(*spilled, "\n"sv);
+				io::append_spilled(*spilled, next);
+				return;
+			}
+			if (!stream.empty()) stream.push_back('\n');
+			stream.append(next);
+		};
 
+		auto const post_deadline = deadline_after(budget.post);
 		for (auto& cmd : calls.second) {
 			if (result.return_code) break;
 
@@ -461,56 +720,120 @@ namespace testbed {
 				                shell::join(cmd.stg)));
 			}
 
-			auto local = io::run({
+			auto local = co_await mt::process{{
 			    .exec = rt.rt_target,
 			    .args = cmd.args(),
-			    .cwd = run_cwd,
+			    .cwd = &cwd(),
 			    .env = &variables,
 			    .output = out_capture.output,
 			    .error = out_capture.error,
 			    .debug = &listing,
-			});
+			    .timeout = remaining(post_deadline),
+			}};
 
 			result.return_code = local.return_code;
+			result.cancelled = local.cancelled;
+			result.timed_out = local.timed_out;
+			result.rusage += local.rusage;
+			if (local.timed_out) timed_out_in = "post"sv;
 
-			if (!result.output.empty() && !local.output.empty())
-				result.output.push_back('\n');
-			result.output.append(local.output);
-
-			if (!result.error.empty() && !local.error.empty())
-				result.error.push_back('\n');
-			result.error.append(local.error);
+			concat(result.output, result.output_spill, local.output);
+			concat(result.error, result.error_spill, local.error);
 		}
 
-		return result;
+		co_return result;
+	}
+
+	mt::co_task<test_run_results> test::run(io::env_block const& variables,
+	                                        runtime const& rt) {
+		co_return co_await bench(variables, rt, 0, 1);
 	}
 
-	test_run_results test::run(
-	    std::map<std::string, std::string> const& variables,
-	    runtime const& rt) {
+	mt::co_task<test_bench_results> test::bench(io::env_block const& variables,
+	                                            runtime const& rt,
+	                                            size_t warmup,
+	                                            size_t count) {
 		// build/.testing/X{16}
 		if (!mkdirs(rt.temp_dir)) {
-			return {{}, std::nullopt};
+			co_return {{{}, std::nullopt}};
 		}
 		if (!rmtree(rt.mocks_dir())) {
-			return {{}, std::nullopt};
+			co_return {{{}, std::nullopt}};
 		}
 
+		reset_timeout();
+		auto const budget = timeout.with_defaults(rt.timeout);
+
 		std::string listing{};
-		if (!run_cmds(rt, prepare, listing))
-			return {std::move(listing), std::nullopt};
+		start_phase(budget.prepare);
+		if (!co_await run_cmds(rt, prepare, listing)) {
+			co_return {{std::move(listing), std::nullopt,
+			            timed_out() ? "prepare"sv : ""sv}};
+		}
 		auto expanded = expand_test_calls(rt);
 		auto const local_env = copy_environment_block(variables, rt);
 
-		auto result = observe(expanded, local_env, rt, listing);
+		std::vector<io::resource_usage> samples{};
+		samples.reserve(count);
+		std::string_view timed_out_in{};
+		io::capture result{};
+		for (size_t index = 0; index < warmup + count; ++index) {
+			result = co_await observe(expanded, local_env, rt, budget,
+			                          listing, timed_out_in);
+			if (rt.debug) listing.append(describe(result.rusage));
+			if (result.cancelled || !timed_out_in.empty()) break;
+			if (index >= warmup) samples.push_back(result.rusage);
+		}
+
+		start_phase(budget.cleanup);
+		if (!co_await run_cmds(rt, cleanup, listing)) {
+			co_return {{std::move(listing), std::nullopt,
+			            timed_out() ? "cleanup"sv : timed_out_in}};
+		}
 
-		if (!run_cmds(rt, cleanup, listing))
-			return {std::move(listing), std::nullopt};
+		fix_streams(result, rt);
 
-		rt.fix(result.output, patches);
-		rt.fix(result.error, patches);
+		co_return {{std::move(listing), std::move(result), timed_out_in},
+		           std::move(samples)};
+	}
+
+	void test::fix_streams(io::capture& actual, runtime const& rt) const {
+		struct stream_ref {
+			testbed::check side;
+			std::string* actual;
+			std::optional<io::spilled>* spilled;
+			std::string const* expected;
+		};
+		std::array streams{
+		    stream_ref{check[0], &actual.output, &actual.output_spill,
+		               expected ? &expected->output : nullptr},
+		    stream_ref{check[1], &actual.error, &actual.error_spill,
+		               expected ? &expected->error : nullptr},
+		};
 
-		return {std::move(listing), std::move(result)};
+		// A spilled stream is read back only as far as the comparison is
+		// going to look at, about the length of the expected text, which
+		// is in memory anyway. It is patched while read, so the lengths
+		// are compared after the patches, like with any other stream.
+		// With nothing expected, only the head in memory is patched.
+		for (auto const& stream : streams) {
+			if (!*stream.spilled || !stream.expected) {
+				rt.fix(*stream.actual, patches);
+				continue;
+			}
+			auto const& file = **stream.spilled;
+			auto const need = stream.expected->size();
+
+			auto const whole =
+			    stream.side == check::end
+			        ? patched_tail(file, need, rt, patches, *stream.actual)
+			        : patched_head(file, need, rt, patches, *stream.actual);
+			// a longer stream than the expected one is not going to match
+			// anyway; the report points to the spill file
+			if (whole ||
+			    (stream.side != check::all && stream.actual->size() >= need))
+				stream.spilled->reset();
+		}
 	}
 
 	io::capture test::clip(io::capture const& actual) const {
@@ -562,14 +885,16 @@ namespace testbed {
 			std::string_view label;
 			std::string_view actual;
 			std::string_view expected;
+			std::optional<io::spilled> const& spilled;
 		};
 		for (auto const& stream : {
 		         stream_ref{check[0], "Standard out"sv, clipped.output,
-		                    expected->output},
+		                    expected->output, clipped.output_spill},
 		         stream_ref{check[1], "Standard err"sv, clipped.error,
-		                    expected->error},
+		                    expected->error, clipped.error_spill},
 		     }) {
-			if (stream.actual == stream.expected) continue;
+			if (stream.actual == stream.expected && !stream.spilled)
+				continue;
 			auto const pre_mark = stream.side == check::end ? "..."sv : ""sv;
 			auto const post_mark = stream.side == check::begin ? "..."sv : ""sv;
 
@@ -589,15 +914,33 @@ namespace testbed {
 			    fmt::arg("pre_mark", pre_mark),
 			    fmt::arg("post_mark", post_mark),
 			    fmt::arg("diff", diff(stream.expected, stream.actual)));
+			if (stream.spilled) {
+				result += fmt::format(
+				    "  (only the first {} of {} bytes are shown above; "
+				    "the whole stream went to {})\n\n",
+				    stream.actual.size(), stream.spilled->size,
+				    shell::get_u8path(stream.spilled->path));
+			}
 		};
 
-		auto const env = copy_environment_block({}, rt);
+		auto const breaches = limits.check(clipped.rusage);
+		if (!breaches.empty()) {
+			result += "Performance budget\n"sv;
+			for (auto const& [name, measured, budget] : breaches) {
+				result += fmt::format("  {}: {:.1f}, over the budget of {}\n",
+				                      name, measured, budget);
+			}
+			result += '\n';
+		}
+
+		// only what the test itself sets, not the whole environment
+		auto const env = copy_environment_block(io::env_block{}, rt);
 		auto const expanded = rt.expand(call_args, stored_env, exp::preferred);
 		std::vector<std::string> ran_cmd{};
-		ran_cmd.reserve(env.size() + rt.reportable_vars.size() + 1 +
+		ran_cmd.reserve(rt.reportable_vars.size() + 1 +
 		                expanded.link_stg.size());
-		for (auto const& [var, value] : env) {
-			ran_cmd.push_back(fmt::format("{}={}", var, value));
+		for (auto entry = env.envp(); *entry; ++entry) {
+			ran_cmd.push_back(*entry);
 		}
 		for (auto const& var : rt.reportable_vars) {
 			ran_cmd.push_back(fmt::format("{}={}", var, shell::getenv(var)));
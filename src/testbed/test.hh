@@ -12,6 +12,8 @@
 #include <variant>
 #include <vector>
 #include "io/run.hh"
+#include "mt/coro.hh"
+#include "testbed/perf_limits.hh"
 #include "testbed/runtime.hh"
 
 namespace fs = std::filesystem;
@@ -22,6 +24,7 @@ namespace testbed {
 
 	using test_variable =
 	    std::variant<std::nullptr_t, std::string, std::vector<std::string>>;
+	using resource_map = std::map<std::string, unsigned>;
 
 	struct test_data {
 		fs::path filename{};
@@ -35,6 +38,9 @@ namespace testbed {
 		std::optional<io::capture> expected{};
 		std::string name = test_name();
 		bool linear{true};
+		resource_map resources{};
+		timeouts timeout{};
+		perf_limits limits{};
 		std::variant<bool, std::string> disabled{false};
 		bool ok{not_disabled()};
 		bool needs_mocks_in_path{false};
@@ -47,6 +53,12 @@ namespace testbed {
 			io::stream_decl output{io::piped{}};
 			io::stream_decl error{io::piped{}};
 		} out_capture{};
+		// standard input of the tested call: the text itself, or a file,
+		// expanded like the arguments and relative to the test directory
+		struct input_t {
+			std::optional<std::string> text{};
+			std::optional<std::string> file{};
+		} input{};
 
 		static test_data load(fs::path const& filename,
 		                      size_t index,
@@ -62,12 +74,17 @@ namespace testbed {
 	struct test_run_results {
 		std::string prepare{};
 		std::optional<io::capture> capture{};
+		// name of the phase, which ran out of time, if any
+		std::string_view timed_out{};
+	};
+	struct test_bench_results : test_run_results {
+		// one for each run after the warmup, until the first failure
+		std::vector<io::resource_usage> samples{};
 	};
 	struct test : test_data, commands {
 		static constexpr size_t HORIZ_SPACE = 20;
 		test(test_data&& data) : test_data{std::move(data)} {}
 
-		bool cd(fs::path const& dir) override;
 		bool store_variable(std::string const& name,
 		                    std::span<std::string const> call,
 		                    std::string& debug) override;
@@ -89,28 +106,43 @@ namespace testbed {
 			return result;
 		}
 
-		bool run_cmds(runtime const&,
-		              std::span<strlist const> commands,
-		              std::string& listing);
+		mt::co_task<bool> run_cmds(runtime const&,
+		                           std::span<strlist const> commands,
+		                           std::string& listing);
 
-		test_run_results run(std::map<std::string, std::string> const&,
-		                     runtime const&);
+		mt::co_task<test_run_results> run(io::env_block const&,
+		                                  runtime const&);
+		// the tested call and its "post" calls, run `warmup` and then
+		// `count` times after a single "prepare"; the capture is the one
+		// of the last run
+		mt::co_task<test_bench_results> bench(io::env_block const&,
+		                                      runtime const&,
+		                                      size_t warmup,
+		                                      size_t count);
 		io::capture clip(io::capture const&) const;
 		std::string report(io::capture const&, runtime const&) const;
 
 		void nullify(std::optional<std::string> const& lang);
 		void store() const;
 
+		// the `variables` with LANGUAGE, `env` and the mocks applied
+		io::env_block copy_environment_block(
+		    io::env_block const& variables,
+		    runtime const& environment) const;
+		std::optional<fs::path> stdin_file(runtime const& environment) const;
+
 	private:
 		std::pair<io::args_storage, std::vector<io::args_storage>>
 		expand_test_calls(runtime const& environment) const;
-		std::map<std::string, std::string> copy_environment_block(
-		    std::map<std::string, std::string> const& variables,
-		    runtime const& environment) const;
-		io::capture observe(
+		mt::co_task<io::capture> observe(
 		    std::pair<io::args_storage, std::vector<io::args_storage>>& calls,
-		    std::map<std::string, std::string> const& variables,
+		    io::env_block const& variables,
 		    runtime const& environment,
-		    std::string& listing) const;
+		    timeouts const& budget,
+		    std::string& listing,
+		    std::string_view& timed_out_in) const;
+		// applies the patches, reading back the spilled streams first
+		void fix_streams(io::capture& actual,
+		                 runtime const& environment) const;
 	};
 }  // namespace testbed
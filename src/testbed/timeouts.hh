@@ -0,0 +1,40 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+namespace testbed {
+	// Budget for each phase of a test; a phase without one is not limited.
+	// The "post" budget covers all the calls listed in the test's "post".
+	struct timeouts {
+		std::optional<std::chrono::milliseconds> prepare{};
+		std::optional<std::chrono::milliseconds> run{};
+		std::optional<std::chrono::milliseconds> post{};
+		std::optional<std::chrono::milliseconds> cleanup{};
+
+		timeouts with_defaults(timeouts const& fallback) const {
+			return {.prepare = prepare ? prepare : fallback.prepare,
+			        .run = run ? run : fallback.run,
+			        .post = post ? post : fallback.post,
+			        .cleanup = cleanup ? cleanup : fallback.cleanup};
+		}
+
+		// nullptr for names other than prepare, run, post and cleanup
+		std::optional<std::chrono::milliseconds>* phase(
+		    std::string_view name) noexcept {
+			if (name == "prepare") return &prepare;
+			if (name == "run") return &run;
+			if (name == "post") return &post;
+			if (name == "cleanup") return &cleanup;
+			return nullptr;
+		}
+
+		static timeouts all(std::chrono::milliseconds budget) {
+			return {budget, budget, budget, budget};
+		}
+	};
+}  // namespace testbed
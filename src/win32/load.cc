@@ -0,0 +1,30 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#define NOMINMAX
+
+#include "io/load.hh"
+#include <Windows.h>
+
+namespace io {
+	namespace {
+		std::uint64_t ticks(FILETIME const& time) {
+			return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) |
+			       time.dwLowDateTime;
+		}
+	}  // namespace
+
+	// Windows has neither the I/O wait, nor the run queue length, and
+	// the CPU time of the children is not summed up for the parent.
+	std::optional<load_sample> sample_load() {
+		FILETIME idle{}, kernel{}, user{};
+		if (!GetSystemTimes(&idle, &kernel, &user)) return std::nullopt;
+
+		// kernel time includes the idle time
+		return load_sample{
+		    .taken = std::chrono::steady_clock::now(),
+		    .busy = ticks(kernel) + ticks(user) - ticks(idle),
+		    .idle = ticks(idle),
+		};
+	}
+}  // namespace io
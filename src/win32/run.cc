@@ -5,16 +5,21 @@
 
 #include "io/run.hh"
 #include <Windows.h>
+#include <Psapi.h>
 #include <errno.h>
 #include <args/parser.hpp>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <string_view>
 #include <thread>
 #include <vector>
 #include "fmt/format.h"
 #include "io/file.hh"
 #include "io/path_env.hh"
+#include "io/program_cache.hh"
 
 namespace io {
 	namespace {
@@ -231,6 +236,22 @@ namespace io {
 				return open_pipe(attrs, debug);
 			}
 
+			bool open_file(fs::path const& path,
+			               SECURITY_ATTRIBUTES* attrs,
+			               std::string& debug) {
+				read = ::CreateFileW(path.c_str(), GENERIC_READ,
+				                     FILE_SHARE_READ, attrs, OPEN_EXISTING,
+				                     FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (read == INVALID_HANDLE_VALUE) {
+					read = nullptr;
+					debug.append(
+					    fmt::format("input: error {:x}\n", GetLastError()));
+					return false;
+				}
+				debug.append(fmt::format("input: -> fd:{}\n", read));
+				return true;
+			}
+
 			bool open(stream_decl const& decl,
 			          pipe direction,
 			          SECURITY_ATTRIBUTES* attrs,
@@ -364,7 +385,12 @@ namespace io {
 		return false;                                                       \
 	}
 
-				OPEN(input);
+				if (opts.input_file) {
+					if (!input.open_file(*opts.input_file, &saAttr, debug))
+						return false;
+				} else {
+					OPEN(input);
+				}
 				OPEN(output);
 				OPEN(error);
 				return true;
@@ -540,19 +566,28 @@ namespace io {
 				return program;
 			}
 
-			auto path_str = env(environment_variable);
-			auto dirs = split<wchar_t>(hint, path_str);
-
-			for (auto const& dir : dirs) {
-				for (auto const ext : path_ext) {
-					auto path = fs::path{dir} / filename(program, ext);
-					if (file_exists(path)) {
-						return path;
-					}
-				}
-			}
+			auto const path_str = env(environment_variable);
+			auto search_path = hint.native();
+			search_path.push_back(L';');
+			search_path.append(path_str);
+			search_path.push_back(L'|');
+			search_path.append(ext_str);
+
+			return program_cache::instance().find(
+			    search_path, program, [&]() -> fs::path {
+				    auto dirs = split<wchar_t>(hint, path_str);
+
+				    for (auto const& dir : dirs) {
+					    for (auto const ext : path_ext) {
+						    auto path = fs::path{dir} / filename(program, ext);
+						    if (file_exists(path)) {
+							    return path;
+						    }
+					    }
+				    }
 
-			return {};
+				    return {};
+			    });
 		}
 
 		fs::path extensionless_where(wchar_t const* environment_variable,
@@ -596,9 +631,100 @@ namespace io {
 		}
 	}  // namespace
 
+	namespace {
+		// Windows has no process groups to signal; the list keeps process
+		// handles, so cancel_all() may terminate them directly.
+		class children_list {
+		public:
+			bool add(DWORD id, HANDLE process) {
+				std::lock_guard lock{m_};
+				running_[id] = process;
+				return !cancelled_;
+			}
+
+			void remove(DWORD id) {
+				std::lock_guard lock{m_};
+				running_.erase(id);
+			}
+
+			bool empty() {
+				std::lock_guard lock{m_};
+				return running_.empty();
+			}
+
+			void terminate_all() {
+				std::lock_guard lock{m_};
+				for (auto const& [_, process] : running_)
+					TerminateProcess(process, ERROR_CANCELLED);
+			}
+
+			void cancel() {
+				std::lock_guard lock{m_};
+				cancelled_ = true;
+			}
+
+			bool cancelled() const noexcept { return cancelled_; }
+			void resume() noexcept { cancelled_ = false; }
+
+		private:
+			std::mutex m_{};
+			std::map<DWORD, HANDLE> running_{};
+			std::atomic<bool> cancelled_{false};
+		};
+
+		children_list& children() {
+			static children_list list{};
+			return list;
+		}
+
+		microseconds from_filetime(FILETIME const& time) {
+			ULARGE_INTEGER value{};
+			value.LowPart = time.dwLowDateTime;
+			value.HighPart = time.dwHighDateTime;
+			// in 100ns ticks
+			return microseconds{value.QuadPart / 10};
+		}
+
+		// no context switches here; page faults are not split into minor
+		// and major ones, they all count as minor
+		resource_usage usage_of(HANDLE process,
+		                        std::chrono::steady_clock::time_point started) {
+			resource_usage result{
+			    .wall = std::chrono::duration_cast<microseconds>(
+			        std::chrono::steady_clock::now() - started),
+			};
+
+			FILETIME creation{}, exit{}, kernel{}, user{};
+			if (GetProcessTimes(process, &creation, &exit, &kernel, &user)) {
+				result.user = from_filetime(user);
+				result.system = from_filetime(kernel);
+			}
+
+			PROCESS_MEMORY_COUNTERS memory{};
+			if (K32GetProcessMemoryInfo(process, &memory, sizeof(memory))) {
+				result.max_rss_kb = memory.PeakWorkingSetSize / 1024;
+				result.minor_faults = memory.PageFaultCount;
+			}
+			return result;
+		}
+	}  // namespace
+
 	capture run(run_opts const& options) {
+		auto const started = std::chrono::steady_clock::now();
 		capture result{};
 
+		if (children().cancelled()) {
+			result.return_code = -ECANCELED;
+			result.cancelled = true;
+			return result;
+		}
+
+		if (options.timeout && options.timeout->count() <= 0) {
+			result.return_code = -ETIMEDOUT;
+			result.timed_out = true;
+			return result;
+		}
+
 		auto const path = locate_file(L"PATH", options.exec);
 		if (path.program_file.empty()) {
 			result.return_code = !path.access ? -EACCES : -ENOENT;
@@ -635,14 +761,10 @@ namespace io {
 		LPVOID environment = nullptr;
 		std::vector<wchar_t> environment_stg;
 		if (options.env) {
-			for (auto const& [key, value] : *options.env) {
-				auto wkey = from_utf8(key);
-				auto wvalue = from_utf8(value);
-				environment_stg.insert(environment_stg.end(), wkey.begin(),
-				                       wkey.end());
-				environment_stg.push_back(L'=');
-				environment_stg.insert(environment_stg.end(), wvalue.begin(),
-				                       wvalue.end());
+			for (auto entry = options.env->envp(); *entry; ++entry) {
+				auto wentry = from_utf8(*entry);
+				environment_stg.insert(environment_stg.end(), wentry.begin(),
+				                       wentry.end());
 				environment_stg.push_back(0);
 			}
 			environment_stg.push_back(0);
@@ -672,10 +794,29 @@ namespace io {
 			// GCOV_EXCL_STOP[WIN32]
 		}  // GCOV_EXCL_LINE
 
+		if (!children().add(pi.dwProcessId, pi.hProcess))
+			TerminateProcess(pi.hProcess, ERROR_CANCELLED);
+
+		std::atomic<bool> timed_out{false};
+		std::thread watchdog{};
+		if (options.timeout) {
+			auto const timeout = static_cast<DWORD>(options.timeout->count());
+			watchdog = std::thread{[&timed_out, process = pi.hProcess,
+			                        timeout] {
+				if (WaitForSingleObject(process, timeout) == WAIT_TIMEOUT) {
+					timed_out = true;
+					TerminateProcess(process, ERROR_TIMEOUT);
+				}
+			}};
+		}
+
 		debug.append(pipes.io(options.input, result));
 
 		DWORD return_code{};
 		WaitForSingleObject(pi.hProcess, INFINITE);
+		if (watchdog.joinable()) watchdog.join();
+		result.timed_out = timed_out;
+		children().remove(pi.dwProcessId);
 		if (!GetExitCodeProcess(pi.hProcess, &return_code)) {
 			// GCOV_EXCL_START[WIN32]
 			[[unlikely]];
@@ -684,13 +825,54 @@ namespace io {
 			// GCOV_EXCL_STOP[WIN32]
 		}  // GCOV_EXCL_LINE
 
+		result.rusage = usage_of(pi.hProcess, started);
 		CloseHandle(pi.hProcess);
 		CloseHandle(pi.hThread);
 
 		result.return_code = static_cast<int>(return_code);
+		result.cancelled =
+		    children().cancelled() && return_code == ERROR_CANCELLED;
 		return result;
 	}
 
+	// no event loop here (yet); the process is waited for on this thread
+	void run_async(run_opts const& options,
+	               std::move_only_function<void(capture&&)> on_done) {
+		on_done(run(options));
+	}
+
+	bool runs_async() noexcept { return false; }
+
+	void cancel_all(std::chrono::milliseconds grace) {
+		children().cancel();
+
+		// there is no SIGTERM to send; give the children a chance to finish
+		// on their own before terminating them
+		auto const deadline = std::chrono::steady_clock::now() + grace;
+		while (std::chrono::steady_clock::now() < deadline) {
+			if (children().empty()) return;
+			std::this_thread::sleep_for(10ms);
+		}
+
+		children().terminate_all();
+	}
+
+	bool cancelled() noexcept { return children().cancelled(); }
+	void resume() noexcept { children().resume(); }
+
+	void cancel_on_signals(std::chrono::milliseconds grace) {
+		static std::chrono::milliseconds saved_grace{};
+		saved_grace = grace;
+		// called on a thread of its own; FALSE lets the default handler
+		// end the runner afterwards
+		SetConsoleCtrlHandler(
+		    [](DWORD) -> BOOL {
+			    cancel_all(saved_grace);
+			    return FALSE;
+		    },
+		    TRUE);
+	}
+
 	std::optional<fs::path> find_program(std::span<std::string const> names,
 	                                     fs::path const& hint) {
 		for (auto const& name : names) {
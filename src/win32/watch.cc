@@ -0,0 +1,18 @@
+// Copyright (c) 2024 Marcin Zdun
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "io/watch.hh"
+
+namespace io {
+	// not implemented with ReadDirectoryChangesW yet; --watch reports it
+	// as unavailable
+	std::unique_ptr<watcher> watcher::create() { return nullptr; }
+	watcher::~watcher() = default;
+	bool watcher::add_tree(fs::path const&) { return false; }
+	bool watcher::add_file(fs::path const&) { return false; }
+	std::vector<fs::path> watcher::wait(std::chrono::milliseconds) {
+		return {};
+	}
+	bool watcher::add_dir(fs::path const&, bool) { return false; }
+	void watcher::read_events(std::set<fs::path>&) {}
+}  // namespace io